@@ -0,0 +1,164 @@
+#include "analysis.hpp"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+const char* analysis_name(int index) {
+    static const char* names[analysis::COUNT] = {"blocks", "cfg", "dominators", "frontiers", "liveness", "reaching"};
+    return index >= 0 && index < analysis::COUNT ? names[index] : "?";
+}
+
+analysis_stats& analysis_stats::operator+=(const analysis_stats& o) {
+    for (int i = 0; i < analysis::COUNT; ++i) {
+        computed[i] += o.computed[i];
+        reused[i] += o.reused[i];
+    }
+    arena_allocations += o.arena_allocations;
+    arena_bytes += o.arena_bytes;
+    cache_hits += o.cache_hits;
+    cache_misses += o.cache_misses;
+    return *this;
+}
+
+function_analyses::function_analyses(const bril_function& func, analysis_options opts) : func_(&func), opts_(opts) {}
+
+function_analyses::function_analyses(const bril_function& func, vector<block> blocks, analysis_options opts)
+    : func_(&func), opts_(opts), valid_(analysis::BLOCKS), blocks_(move(blocks)) {}
+
+// counts the lookup; on a miss the caller computes the analysis, which is
+// then valid
+bool function_analyses::cached(analysis_set a) {
+    int index = __builtin_ctz(a);
+    if (valid_ & a) {
+        ++stats_.reused[index];
+        return true;
+    }
+    ++stats_.computed[index];
+    valid_ |= a;
+    return false;
+}
+
+const vector<block>& function_analyses::blocks() {
+    if (!cached(analysis::BLOCKS)) blocks_ = gen_basic_blocks(*func_);
+    return blocks_;
+}
+
+const cfg_info& function_analyses::cfg() {
+    if (!cached(analysis::CFG)) cfg_ = build_cfg(*func_, blocks());
+    return cfg_;
+}
+
+const dominator_tree& function_analyses::dom_tree() {
+    if (!cached(analysis::DOMINATORS)) dom_tree_ = build_dom_tree(immediate_dominators(cfg(), opts_.engine));
+    return dom_tree_;
+}
+
+const vector<vector<block_id>>& function_analyses::frontiers() {
+    if (!cached(analysis::FRONTIERS)) frontiers_ = dominance_frontier(cfg(), dom_tree());
+    return frontiers_;
+}
+
+const dataflow_result& function_analyses::liveness() {
+    if (!cached(analysis::LIVENESS)) {
+        liveness_ = live_variables(*func_, blocks(), cfg(), opts_.solver, opts_.threads);
+    }
+    return liveness_;
+}
+
+const reaching_result& function_analyses::reaching() {
+    if (!cached(analysis::REACHING)) {
+        reaching_ = reaching_definitions(*func_, blocks(), cfg(), opts_.solver, opts_.threads);
+    }
+    return reaching_;
+}
+
+void function_analyses::invalidate(analysis_set preserved) {
+    analysis_set keep = valid_ & preserved;
+    if (!(keep & analysis::CFG)) keep &= ~(analysis::DOMINATORS | analysis::LIVENESS | analysis::REACHING);
+    if (!(keep & analysis::DOMINATORS)) keep &= ~analysis::FRONTIERS;
+    if (!(keep & analysis::BLOCKS)) keep &= ~(analysis::LIVENESS | analysis::REACHING);
+    valid_ = keep;
+}
+
+// ---------------------------------------------------------------------------
+// Tool input
+// ---------------------------------------------------------------------------
+
+const char* const tool_input_usage = "[-j N | --stream] [--func PATTERN]... [--text | --binary]";
+
+bool parse_tool_input_flag(int argc, char** argv, int& i, tool_input& input) {
+    string arg = argv[i];
+    if (arg == "-j" && i + 1 < argc && parse_number_flag(argv[i + 1], input.jobs)) {
+        ++i;
+    } else if (arg == "--stream") {
+        input.stream = true;
+    } else if (arg == "--func" && i + 1 < argc) {
+        input.funcs.add(argv[++i]);
+    } else {
+        return parse_format_flag(arg, input.formats);
+    }
+    return true;
+}
+
+unsigned threads_per_function(const tool_input& input, unsigned threads) {
+    if (threads) return threads;
+    unsigned hardware = max(1u, thread::hardware_concurrency());
+    unsigned jobs = input.stream ? 1 : input.jobs ? input.jobs : hardware;
+    return max(1u, hardware / jobs);
+}
+
+void analyze_functions(istream& in, const tool_input& input,
+                       const function<void(const bril_function&, ostream&, ostream&)>& analyze_one) {
+    // each function's scratch data comes from the thread's arena, reset per function
+    auto analyze = [&](const bril_function& func, ostream& out, ostream& err) {
+        thread_arena_scope scope;
+        analyze_one(func, out, err);
+    };
+
+    if (input.stream && input.formats.in == io_format::json && !input_bytes::mappable(in)) {
+        // a pipe: parse as it arrives so memory stays bounded
+        read_program_streaming(in, [&](bril_function& func) {
+            // a function with no "name" has no symbol; it matches as "", as
+            // the scanner on the other path reads it
+            string name = func.name != no_sym ? sym_name(func.name) : string();
+            if (input.funcs.matches(name)) analyze(func, cout, cerr);
+        });
+        return;
+    }
+
+    input_bytes bytes(in);
+    lazy_program prog(bytes, input.formats.in);
+    vector<size_t> selected;
+    for (size_t f = 0; f < prog.size(); ++f) {
+        if (input.funcs.matches(prog.name(f))) selected.push_back(f);
+    }
+
+    if (input.stream) {
+        for (size_t f : selected) {
+            bril_function func = prog.function(f);
+            analyze(func, cout, cerr);
+        }
+        return;
+    }
+
+    // decode on this thread; binary_program is not safe to share
+    size_t n = selected.size();
+    vector<bril_function> funcs(n);
+    for (size_t k = 0; k < n; ++k) funcs[k] = prog.function(selected[k]);
+
+    vector<string> outs(n), errs(n);
+    auto cost = [&](size_t k) { return funcs[k].instrs.size(); };
+    for_each_largest_first(n, input.jobs, cost, [&](size_t k) {
+        ostringstream out, err;
+        analyze(funcs[k], out, err);
+        outs[k] = out.str();
+        errs[k] = err.str();
+    });
+    for (size_t k = 0; k < n; ++k) {
+        cerr << errs[k];
+        cout << outs[k];
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include "common.hpp"
+#include "bril_io.hpp"
+#include "dataflow.hpp"
+#include "dominators.hpp"
+#include <optional>
+
+// Per-function analysis cache. Each analysis is computed on first request
+// and kept until a pass that does not preserve it runs, so chained passes
+// and the tools share one CFG, dominator tree, frontier and dataflow solve.
+//
+// An analysis is only valid while everything it is built from is: dropping
+// the CFG drops dominators, frontiers, liveness and reaching definitions,
+// and dropping the blocks drops the dataflow results too.
+
+using analysis_set = unsigned;
+
+struct analysis {
+    static constexpr analysis_set NONE = 0;
+    static constexpr analysis_set BLOCKS = 1 << 0;     // gen_basic_blocks
+    static constexpr analysis_set CFG = 1 << 1;        // block ids, labels and edges
+    static constexpr analysis_set DOMINATORS = 1 << 2; // dominator tree
+    static constexpr analysis_set FRONTIERS = 1 << 3;
+    static constexpr analysis_set LIVENESS = 1 << 4;
+    static constexpr analysis_set REACHING = 1 << 5;
+    static constexpr analysis_set ALL = (1 << 6) - 1;
+    static constexpr int COUNT = 6;
+};
+
+const char* analysis_name(int index); // bit index -> "cfg", "dominators", ...
+
+struct analysis_options {
+    dom_engine engine = dom_engine::chk;
+    solve_mode solver = solve_mode::worklist;
+    unsigned threads = 0;
+};
+
+// how often each analysis was computed and served from the cache, and what
+// the passes took from their function arenas
+struct analysis_stats {
+    size_t computed[analysis::COUNT] = {};
+    size_t reused[analysis::COUNT] = {};
+    size_t arena_allocations = 0;
+    size_t arena_bytes = 0;
+    size_t cache_hits = 0; // functions the function cache answered
+    size_t cache_misses = 0;
+
+    analysis_stats& operator+=(const analysis_stats& o);
+};
+
+class function_analyses {
+public:
+    explicit function_analyses(const bril_function& func, analysis_options opts = {});
+    // seed the blocks with a custom split (e.g. with an extra entry block);
+    // they stay until invalidated like any other analysis
+    function_analyses(const bril_function& func, std::vector<block> blocks, analysis_options opts = {});
+
+    const std::vector<block>& blocks();
+    const cfg_info& cfg();
+    const dominator_tree& dom_tree();
+    const std::vector<std::vector<block_id>>& frontiers();
+    const dataflow_result& liveness();
+    const reaching_result& reaching();
+
+    // drop every cached analysis not in `preserved`, plus whatever depends
+    // on a dropped one
+    void invalidate(analysis_set preserved = analysis::NONE);
+
+    const analysis_stats& stats() const { return stats_; }
+
+private:
+    bool cached(analysis_set a);
+
+    const bril_function* func_;
+    analysis_options opts_;
+    analysis_set valid_ = analysis::NONE;
+    analysis_stats stats_;
+
+    std::vector<block> blocks_;
+    cfg_info cfg_;
+    dominator_tree dom_tree_;
+    std::vector<std::vector<block_id>> frontiers_;
+    dataflow_result liveness_;
+    reaching_result reaching_;
+};
+
+// ---------------------------------------------------------------------------
+// Shared input handling of the analysis tools (reaching_definitions,
+// dataflow_util, dominator_util)
+// ---------------------------------------------------------------------------
+
+struct tool_input {
+    io_formats formats; // only the input side applies
+    unsigned jobs = 1;
+    bool stream = false;
+    function_filter funcs;
+};
+
+// Takes -j N, --stream, --func PATTERN and the format flags at argv[i],
+// moving i past a flag's value; false if argv[i] is none of these.
+bool parse_tool_input_flag(int argc, char** argv, int& i, tool_input& input);
+
+// usage text for the flags above
+extern const char* const tool_input_usage;
+
+// Threads for the work inside one function (the parallel solver, --verify):
+// `threads` if set, otherwise the hardware split among the functions -j
+// runs at once, so -j N does not start N machines' worth of threads.
+unsigned threads_per_function(const tool_input& input, unsigned threads);
+
+// Calls analyze(func, out, err) on every function selected by --func, then
+// prints what each wrote to `out` to stdout and to `err` to stderr, in
+// program order. Only selected functions are decoded (see lazy_program).
+// With -j N they are analyzed N at a time; with --stream each is decoded
+// just before it is analyzed, and piped json input is parsed as it arrives.
+void analyze_functions(std::istream& in, const tool_input& input,
+                       const std::function<void(const bril_function&, std::ostream&, std::ostream&)>& analyze);
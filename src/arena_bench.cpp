@@ -0,0 +1,95 @@
+#include "passes.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+
+using namespace std;
+
+// Heap traffic and run time of a pass pipeline with and without function
+// arenas.
+// usage: arena_bench FILE [PIPELINE] [reps]
+// Counts every operator new made while the passes run (loading and writing
+// the program are left out), prints the best time of `reps` runs, and fails
+// if the two settings produce different programs.
+
+static size_t heap_allocations = 0;
+
+void* operator new(size_t n) {
+    ++heap_allocations;
+    if (void* p = malloc(n ? n : 1)) return p;
+    throw bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// to_ssa reports every block it renames; keep that out of the timings
+struct null_buffer : streambuf {
+    int overflow(int c) override { return c; }
+};
+
+struct result {
+    size_t heap = 0;
+    analysis_stats stats;
+    double seconds = 1e300;
+    string output;
+};
+
+static result measure(const program& input, const vector<const pass*>& passes, bool arenas, int reps) {
+    set_arenas_enabled(arenas);
+    result r;
+    for (int k = 0; k < reps; ++k) {
+        program prog = input;
+        analysis_stats stats;
+        size_t before = heap_allocations;
+        auto start = chrono::steady_clock::now();
+        run_pipeline(prog, passes, &stats);
+        r.seconds = min(r.seconds, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        r.heap = heap_allocations - before;
+        r.stats = stats;
+        if (k == 0) {
+            ostringstream out;
+            write_program(out, prog);
+            r.output = out.str();
+        }
+    }
+    return r;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        cerr << "usage: arena_bench FILE [PIPELINE] [reps]\n";
+        return 1;
+    }
+    ifstream file(argv[1]);
+    program input = read_program(file);
+    string spec = argc > 2 ? argv[2] : "to_ssa,lvn,tdce,from_ssa";
+    int reps = argc > 3 ? stoi(argv[3]) : 3;
+
+    vector<const pass*> passes;
+    string error;
+    if (!parse_pipeline(spec, passes, error)) {
+        cerr << "arena_bench: " << error << "\n";
+        return 1;
+    }
+
+    null_buffer quiet;
+    streambuf* saved = cerr.rdbuf(&quiet);
+    result heap = measure(input, passes, false, reps);
+    result arena = measure(input, passes, true, reps);
+    cerr.rdbuf(saved);
+
+    cout << "pipeline\t" << spec << ", " << input.functions.size() << " functions\n";
+    cout << "arenas\theap allocs\tarena allocs\tarena KB\tseconds\n";
+    cout << "off\t" << heap.heap << "\t0\t0\t" << heap.seconds << "\n";
+    cout << "on\t" << arena.heap << "\t" << arena.stats.arena_allocations << "\t"
+         << arena.stats.arena_bytes / 1024 << "\t" << arena.seconds << "\t(" << heap.seconds / arena.seconds
+         << "x, " << (double)heap.heap / max<size_t>(arena.heap, 1) << "x fewer heap allocs)\n";
+    if (heap.output != arena.output) {
+        cerr << "output differs with arenas on\n";
+        return 1;
+    }
+    return 0;
+}
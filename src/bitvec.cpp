@@ -0,0 +1,252 @@
+#include "bitvec.hpp"
+#include <atomic>
+
+#if defined(__x86_64__)
+#define BITVEC_X86 1
+#include <immintrin.h>
+#endif
+
+// ---------------------------------------------------------------------------
+// Scalar kernels: always available, and the tail loop of the wide ones.
+// ---------------------------------------------------------------------------
+
+static void scalar_or(uint64_t* d, const uint64_t* s, size_t n) {
+    for (size_t i = 0; i < n; ++i) d[i] |= s[i];
+}
+static void scalar_and(uint64_t* d, const uint64_t* s, size_t n) {
+    for (size_t i = 0; i < n; ++i) d[i] &= s[i];
+}
+static void scalar_andnot(uint64_t* d, const uint64_t* s, size_t n) {
+    for (size_t i = 0; i < n; ++i) d[i] &= ~s[i];
+}
+static void scalar_transfer(uint64_t* d, const uint64_t* in, const uint64_t* gen, const uint64_t* kill, size_t n) {
+    for (size_t i = 0; i < n; ++i) d[i] = gen[i] | (in[i] & ~kill[i]);
+}
+static bool scalar_equal(const uint64_t* a, const uint64_t* b, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+        if (a[i] != b[i]) return false;
+    }
+    return true;
+}
+static size_t scalar_popcount(const uint64_t* a, size_t n) {
+    size_t c = 0;
+    for (size_t i = 0; i < n; ++i) c += __builtin_popcountll(a[i]);
+    return c;
+}
+
+static const bitvec_kernels scalar_kernels = {
+    scalar_or, scalar_and, scalar_andnot, scalar_transfer, scalar_equal, scalar_popcount,
+};
+
+#ifdef BITVEC_X86
+
+// ---------------------------------------------------------------------------
+// AVX2: 4 words per step
+// ---------------------------------------------------------------------------
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static void avx2_or(uint64_t* d, const uint64_t* s, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(d + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(s + i));
+        _mm256_storeu_si256((__m256i*)(d + i), _mm256_or_si256(x, y));
+    }
+    scalar_or(d + i, s + i, n - i);
+}
+AVX2 static void avx2_and(uint64_t* d, const uint64_t* s, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(d + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(s + i));
+        _mm256_storeu_si256((__m256i*)(d + i), _mm256_and_si256(x, y));
+    }
+    scalar_and(d + i, s + i, n - i);
+}
+AVX2 static void avx2_andnot(uint64_t* d, const uint64_t* s, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(d + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(s + i));
+        _mm256_storeu_si256((__m256i*)(d + i), _mm256_andnot_si256(y, x));
+    }
+    scalar_andnot(d + i, s + i, n - i);
+}
+AVX2 static void avx2_transfer(uint64_t* d, const uint64_t* in, const uint64_t* gen, const uint64_t* kill, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(in + i));
+        __m256i g = _mm256_loadu_si256((const __m256i*)(gen + i));
+        __m256i k = _mm256_loadu_si256((const __m256i*)(kill + i));
+        _mm256_storeu_si256((__m256i*)(d + i), _mm256_or_si256(g, _mm256_andnot_si256(k, x)));
+    }
+    scalar_transfer(d + i, in + i, gen + i, kill + i, n - i);
+}
+AVX2 static bool avx2_equal(const uint64_t* a, const uint64_t* b, size_t n) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i x = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i*)(b + i));
+        __m256i diff = _mm256_xor_si256(x, y);
+        if (!_mm256_testz_si256(diff, diff)) return false;
+    }
+    return scalar_equal(a + i, b + i, n - i);
+}
+// nibble lookup (Mula et al.), summed per 64-bit lane with vpsadbw
+AVX2 static size_t avx2_popcount(const uint64_t* a, size_t n) {
+    const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                            0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i low = _mm256_set1_epi8(0x0f);
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(a + i));
+        __m256i lo = _mm256_and_si256(v, low);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+        __m256i cnt = _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+        acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+    }
+    size_t c = (size_t)_mm256_extract_epi64(acc, 0) + (size_t)_mm256_extract_epi64(acc, 1) +
+               (size_t)_mm256_extract_epi64(acc, 2) + (size_t)_mm256_extract_epi64(acc, 3);
+    return c + scalar_popcount(a + i, n - i);
+}
+
+static const bitvec_kernels avx2_kernels = {
+    avx2_or, avx2_and, avx2_andnot, avx2_transfer, avx2_equal, avx2_popcount,
+};
+
+// ---------------------------------------------------------------------------
+// AVX-512: 8 words per step. vpopcntq is a separate extension, so popcount
+// falls back to the AVX2 kernel on CPUs without it.
+// ---------------------------------------------------------------------------
+
+#define AVX512 __attribute__((target("avx512f")))
+
+AVX512 static void avx512_or(uint64_t* d, const uint64_t* s, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_si512(d + i, _mm512_or_si512(_mm512_loadu_si512(d + i), _mm512_loadu_si512(s + i)));
+    }
+    scalar_or(d + i, s + i, n - i);
+}
+AVX512 static void avx512_and(uint64_t* d, const uint64_t* s, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm512_storeu_si512(d + i, _mm512_and_si512(_mm512_loadu_si512(d + i), _mm512_loadu_si512(s + i)));
+    }
+    scalar_and(d + i, s + i, n - i);
+}
+AVX512 static void avx512_andnot(uint64_t* d, const uint64_t* s, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        // 0x30 = a & ~b (c unused); plain vpandnq trips gcc's -Wmaybe-uninitialized
+        __m512i x = _mm512_loadu_si512(d + i), y = _mm512_loadu_si512(s + i);
+        _mm512_storeu_si512(d + i, _mm512_ternarylogic_epi64(x, y, y, 0x30));
+    }
+    scalar_andnot(d + i, s + i, n - i);
+}
+AVX512 static void avx512_transfer(uint64_t* d, const uint64_t* in, const uint64_t* gen, const uint64_t* kill, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        // 0xF4 = a | (b & ~c) for (a, b, c) = (gen, in, kill)
+        __m512i r = _mm512_ternarylogic_epi64(_mm512_loadu_si512(gen + i), _mm512_loadu_si512(in + i),
+                                              _mm512_loadu_si512(kill + i), 0xF4);
+        _mm512_storeu_si512(d + i, r);
+    }
+    scalar_transfer(d + i, in + i, gen + i, kill + i, n - i);
+}
+AVX512 static bool avx512_equal(const uint64_t* a, const uint64_t* b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        if (_mm512_cmpneq_epu64_mask(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i))) return false;
+    }
+    return scalar_equal(a + i, b + i, n - i);
+}
+__attribute__((target("avx512f,avx512vpopcntdq"))) static size_t avx512_popcount(const uint64_t* a, size_t n) {
+    __m512i acc = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        acc = _mm512_add_epi64(acc, _mm512_popcnt_epi64(_mm512_loadu_si512(a + i)));
+    }
+    uint64_t lanes[8];
+    _mm512_storeu_si512(lanes, acc);
+    size_t c = 0;
+    for (uint64_t l : lanes) c += l;
+    return c + scalar_popcount(a + i, n - i);
+}
+
+static const bitvec_kernels avx512_kernels = {
+    avx512_or, avx512_and, avx512_andnot, avx512_transfer, avx512_equal, avx512_popcount,
+};
+static const bitvec_kernels avx512_kernels_no_vpopcnt = {
+    avx512_or, avx512_and, avx512_andnot, avx512_transfer, avx512_equal, avx2_popcount,
+};
+
+#endif
+
+bool bitvec_isa_supported(bitvec_isa isa) {
+#ifdef BITVEC_X86
+    __builtin_cpu_init();
+    switch (isa) {
+    case bitvec_isa::scalar: return true;
+    case bitvec_isa::avx2: return __builtin_cpu_supports("avx2");
+    case bitvec_isa::avx512: return __builtin_cpu_supports("avx512f");
+    }
+    return false;
+#else
+    return isa == bitvec_isa::scalar;
+#endif
+}
+
+static const bitvec_kernels* kernels_for(bitvec_isa isa) {
+#ifdef BITVEC_X86
+    if (isa == bitvec_isa::avx512) {
+        return __builtin_cpu_supports("avx512vpopcntdq") ? &avx512_kernels : &avx512_kernels_no_vpopcnt;
+    }
+    if (isa == bitvec_isa::avx2) return &avx2_kernels;
+#endif
+    return &scalar_kernels;
+}
+
+static bitvec_isa best_isa() {
+    if (bitvec_isa_supported(bitvec_isa::avx512)) return bitvec_isa::avx512;
+    if (bitvec_isa_supported(bitvec_isa::avx2)) return bitvec_isa::avx2;
+    return bitvec_isa::scalar;
+}
+
+// picked on first use rather than by a static initializer, so bitvecs built
+// during other translation units' static init still work; atomic because
+// that first use may come from several solver threads at once
+static std::atomic<bitvec_isa> current_isa{bitvec_isa::scalar};
+static std::atomic<const bitvec_kernels*> current{nullptr};
+
+const bitvec_kernels& active_bitvec_kernels() {
+    const bitvec_kernels* k = current.load(std::memory_order_acquire);
+    if (!k) {
+        set_bitvec_isa(best_isa());
+        k = current.load(std::memory_order_acquire);
+    }
+    return *k;
+}
+
+bitvec_isa active_bitvec_isa() {
+    active_bitvec_kernels();
+    return current_isa.load();
+}
+
+bool set_bitvec_isa(bitvec_isa isa) {
+    if (!bitvec_isa_supported(isa)) return false;
+    current_isa.store(isa);
+    current.store(kernels_for(isa), std::memory_order_release);
+    return true;
+}
+
+const char* bitvec_isa_name(bitvec_isa isa) {
+    switch (isa) {
+    case bitvec_isa::scalar: return "scalar";
+    case bitvec_isa::avx2: return "avx2";
+    case bitvec_isa::avx512: return "avx512";
+    }
+    return "?";
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// Word kernels behind bitvec. One table per instruction set; the best one the
+// CPU supports (AVX-512, AVX2, else portable scalar code) is picked on first
+// use. Non-x86 builds only have the scalar table.
+// ---------------------------------------------------------------------------
+
+enum class bitvec_isa { scalar, avx2, avx512 };
+
+struct bitvec_kernels {
+    void (*or_into)(uint64_t* dst, const uint64_t* src, size_t n);     // dst |= src
+    void (*and_into)(uint64_t* dst, const uint64_t* src, size_t n);    // dst &= src
+    void (*andnot_into)(uint64_t* dst, const uint64_t* src, size_t n); // dst &= ~src
+    // dst = gen | (in & ~kill)
+    void (*transfer)(uint64_t* dst, const uint64_t* in, const uint64_t* gen, const uint64_t* kill, size_t n);
+    bool (*equal)(const uint64_t* a, const uint64_t* b, size_t n);
+    size_t (*popcount)(const uint64_t* a, size_t n);
+};
+
+const bitvec_kernels& active_bitvec_kernels();
+bitvec_isa active_bitvec_isa();
+bool bitvec_isa_supported(bitvec_isa isa);
+// switch every bitvec over to another table (benchmarks); false if the CPU
+// can't run it
+bool set_bitvec_isa(bitvec_isa isa);
+const char* bitvec_isa_name(bitvec_isa isa);
+
+// Fixed-width dense bit vector for dataflow facts. Bits past size() in the
+// last word are always zero, so word-wise comparisons and counts are exact.
+// Vectors of a few words skip the dispatch and use inline loops.
+class bitvec {
+public:
+    bitvec() = default;
+    explicit bitvec(size_t bits, bool value = false) { assign(bits, value); }
+
+    void assign(size_t bits, bool value) {
+        bits_ = bits;
+        words_.assign((bits + 63) / 64, value ? ~uint64_t(0) : 0);
+        trim();
+    }
+
+    size_t size() const { return bits_; }
+    bool test(size_t i) const { return words_[i / 64] >> (i % 64) & 1; }
+    void set(size_t i) { words_[i / 64] |= uint64_t(1) << (i % 64); }
+    void reset(size_t i) { words_[i / 64] &= ~(uint64_t(1) << (i % 64)); }
+
+    bitvec& operator|=(const bitvec& o) {
+        if (small()) {
+            for (size_t w = 0; w < words_.size(); ++w) words_[w] |= o.words_[w];
+        } else {
+            active_bitvec_kernels().or_into(words_.data(), o.words_.data(), words_.size());
+        }
+        return *this;
+    }
+    bitvec& operator&=(const bitvec& o) {
+        if (small()) {
+            for (size_t w = 0; w < words_.size(); ++w) words_[w] &= o.words_[w];
+        } else {
+            active_bitvec_kernels().and_into(words_.data(), o.words_.data(), words_.size());
+        }
+        return *this;
+    }
+    // this &= ~o
+    bitvec& andnot(const bitvec& o) {
+        if (small()) {
+            for (size_t w = 0; w < words_.size(); ++w) words_[w] &= ~o.words_[w];
+        } else {
+            active_bitvec_kernels().andnot_into(words_.data(), o.words_.data(), words_.size());
+        }
+        return *this;
+    }
+    // this = gen | (in & ~kill), all of the same width
+    void assign_transfer(const bitvec& in, const bitvec& gen, const bitvec& kill) {
+        bits_ = in.bits_;
+        words_.resize(in.words_.size());
+        if (small()) {
+            for (size_t w = 0; w < words_.size(); ++w) words_[w] = gen.words_[w] | (in.words_[w] & ~kill.words_[w]);
+        } else {
+            active_bitvec_kernels().transfer(words_.data(), in.words_.data(), gen.words_.data(), kill.words_.data(), words_.size());
+        }
+    }
+
+    bool operator==(const bitvec& o) const {
+        if (bits_ != o.bits_) return false;
+        if (small()) return words_ == o.words_;
+        return active_bitvec_kernels().equal(words_.data(), o.words_.data(), words_.size());
+    }
+    bool operator!=(const bitvec& o) const { return !(*this == o); }
+
+    size_t count() const {
+        if (small()) {
+            size_t n = 0;
+            for (uint64_t w : words_) n += __builtin_popcountll(w);
+            return n;
+        }
+        return active_bitvec_kernels().popcount(words_.data(), words_.size());
+    }
+
+    // calls f(i) for every set bit, in increasing order
+    template <typename F>
+    void for_each(F f) const {
+        for (size_t w = 0; w < words_.size(); ++w) {
+            for (uint64_t bits = words_[w]; bits; bits &= bits - 1) f(w * 64 + __builtin_ctzll(bits));
+        }
+    }
+
+    const uint64_t* words() const { return words_.data(); }
+    size_t word_count() const { return words_.size(); }
+
+private:
+    bool small() const { return words_.size() <= 4; }
+    void trim() {
+        if (bits_ % 64 && !words_.empty()) words_.back() &= (uint64_t(1) << (bits_ % 64)) - 1;
+    }
+
+    size_t bits_ = 0;
+    std::vector<uint64_t> words_;
+};
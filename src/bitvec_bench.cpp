@@ -0,0 +1,73 @@
+#include "bitvec.hpp"
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace std;
+
+// Times every bitvec kernel under each instruction set the CPU supports.
+// usage: bitvec_bench [bits]
+// Prints ns per call and the speedup over the scalar kernels.
+
+static bitvec random_bits(size_t n, mt19937_64& rng) {
+    bitvec v(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (rng() & 1) v.set(i);
+    }
+    return v;
+}
+
+// ns per call, best of 5 runs
+static double time_ns(size_t reps, const function<void()>& op) {
+    double best = 1e300;
+    for (int run = 0; run < 5; ++run) {
+        auto start = chrono::steady_clock::now();
+        for (size_t r = 0; r < reps; ++r) op();
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / reps;
+        best = min(best, ns);
+    }
+    return best;
+}
+
+int main(int argc, char** argv) {
+    vector<size_t> sizes = {1024, 50000, 1 << 20};
+    if (argc > 1) sizes = {stoul(argv[1])};
+
+    const bitvec_isa isas[] = {bitvec_isa::scalar, bitvec_isa::avx2, bitvec_isa::avx512};
+    const char* ops[] = {"or", "and", "andnot", "transfer", "equal", "popcount"};
+
+    mt19937_64 rng(6120);
+    size_t sink = 0; // keeps results live
+    cout << "bits\top\tisa\tns\tspeedup\n";
+    for (size_t bits : sizes) {
+        bitvec a = random_bits(bits, rng), b = random_bits(bits, rng), c = random_bits(bits, rng);
+        bitvec a_copy = a, d(bits);
+        size_t reps = max<size_t>(1, (size_t)(200'000'000 / bits));
+
+        for (const char* op : ops) {
+            string name = op;
+            function<void()> f;
+            if (name == "or") f = [&] { d |= b; };
+            else if (name == "and") f = [&] { d &= b; };
+            else if (name == "andnot") f = [&] { d.andnot(b); };
+            else if (name == "transfer") f = [&] { d.assign_transfer(a, b, c); };
+            else if (name == "equal") f = [&] { sink += a == a_copy; }; // full scan
+            else f = [&] { sink += a.count(); };
+
+            double scalar_ns = 0;
+            for (bitvec_isa isa : isas) {
+                if (!set_bitvec_isa(isa)) continue;
+                d = a;
+                double ns = time_ns(reps, f);
+                if (isa == bitvec_isa::scalar) scalar_ns = ns;
+                cout << bits << "\t" << name << "\t" << bitvec_isa_name(isa) << "\t" << fixed << setprecision(1) << ns
+                     << "\t" << setprecision(2) << scalar_ns / ns << "x\n";
+            }
+        }
+    }
+    cerr << "(" << sink << ")\n";
+    return 0;
+}
@@ -0,0 +1,300 @@
+#include "bril_binary.hpp"
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+// ---------------------------------------------------------------------------
+// Writer
+// ---------------------------------------------------------------------------
+
+binary_writer::binary_writer(std::ostream &out) : out_(out) {}
+
+void binary_writer::start()
+{
+    if (written_ > 0)
+        return;
+    put(binary_magic, sizeof binary_magic);
+    put(&binary_version, sizeof binary_version);
+}
+
+void binary_writer::put(const void *p, size_t n)
+{
+    out_.write(static_cast<const char *>(p), n);
+    written_ += n;
+}
+
+void binary_writer::pad()
+{
+    static const char zeros[8] = {};
+    put(zeros, -written_ & 7);
+}
+
+uint32_t binary_writer::local(sym s)
+{
+    if (s == no_sym)
+        return no_sym;
+    auto [it, inserted] = ids_.try_emplace(s, (uint32_t)strings_.size());
+    if (inserted)
+        strings_.push_back(s);
+    return it->second;
+}
+
+void binary_writer::write_function(const bril_function &func)
+{
+    std::string extras = func.extras.empty() ? "" : json(func.extras).dump();
+    std::string extra = func.extra.empty() ? "" : func.extra.dump();
+
+    binary_func h;
+    h.name = local(func.name);
+    h.type = local(func.type);
+    h.has_args = func.has_args;
+    h.n_args = func.args.size();
+    h.n_instrs = func.instrs.size();
+    h.n_operands = func.operands.size();
+    h.extras_len = extras.size();
+    h.extra_len = extra.size();
+
+    start();
+    binary_index_entry entry{written_, 0, h.name, h.n_instrs};
+    put(&h, sizeof h);
+
+    std::vector<binary_instr> records(func.instrs.size());
+    for (size_t k = 0; k < func.instrs.size(); ++k)
+    {
+        const instr &i = func.instrs[k];
+        binary_instr &r = records[k];
+        r.op = opcode_code(i.op);
+        r.present = i.present;
+        r.literal_kind = i.value.kind;
+        r.dest = local(i.dest);
+        r.type = local(i.type);
+        r.label = local(i.label);
+        r.args_off = i.args.off;
+        r.args_len = i.args.len;
+        r.funcs_off = i.funcs.off;
+        r.funcs_len = i.funcs.len;
+        r.labels_off = i.labels.off;
+        r.labels_len = i.labels.len;
+        r.extra = i.extra;
+        r.value = i.value.kind == literal::char_ ? local(i.value.c) : i.value.u;
+    }
+    put(records.data(), records.size() * sizeof(binary_instr));
+
+    std::vector<uint32_t> ids;
+    ids.reserve(2 * func.args.size() + func.operands.size());
+    for (const auto &a : func.args)
+    {
+        ids.push_back(local(a.name));
+        ids.push_back(local(a.type));
+    }
+    for (sym s : func.operands)
+        ids.push_back(local(s));
+    put(ids.data(), ids.size() * sizeof(uint32_t));
+
+    put(extras.data(), extras.size());
+    put(extra.data(), extra.size());
+    pad();
+    entry.size = written_ - entry.offset;
+    index_.push_back(entry);
+}
+
+void binary_writer::finish(const json &extra)
+{
+    start();
+    binary_trailer t;
+    std::memcpy(t.magic, binary_magic, sizeof binary_magic);
+
+    t.strings_offset = written_;
+    t.n_strings = strings_.size();
+    uint32_t off = 0;
+    std::vector<uint32_t> offsets{0};
+    for (sym s : strings_)
+        offsets.push_back(off += sym_name(s).size());
+    put(offsets.data(), offsets.size() * sizeof(uint32_t));
+    for (sym s : strings_)
+        put(sym_name(s).data(), sym_name(s).size());
+    pad();
+
+    t.index_offset = written_;
+    t.n_functions = index_.size();
+    put(index_.data(), index_.size() * sizeof(binary_index_entry));
+
+    std::string text = extra.empty() ? "" : extra.dump();
+    t.extra_offset = written_;
+    t.extra_len = text.size();
+    put(text.data(), text.size());
+    pad();
+
+    put(&t, sizeof t);
+    out_.flush();
+}
+
+void write_program_binary(std::ostream &out, const program &prog)
+{
+    binary_writer writer(out);
+    for (const auto &func : prog.functions)
+        writer.write_function(func);
+    writer.finish(prog.extra);
+}
+
+// ---------------------------------------------------------------------------
+// Reader
+// ---------------------------------------------------------------------------
+
+[[noreturn]] static void corrupt(const std::string &what)
+{
+    throw std::runtime_error("bad binary bril program: " + what);
+}
+
+// binary opcode code -> opcode; codes no opcode has map to no_opcode
+constexpr uint8_t no_opcode = 0xff;
+
+struct opcode_decoder
+{
+    uint8_t by_code[256] = {};
+    bool unique = true;
+
+    constexpr opcode_decoder()
+    {
+        for (auto &op : by_code)
+            op = no_opcode;
+        for (size_t op = 0; op <= (size_t)opcode::unknown; ++op)
+        {
+            uint8_t code = opcode_table[op].code;
+            unique &= by_code[code] == no_opcode;
+            by_code[code] = (uint8_t)op;
+        }
+    }
+};
+
+static constexpr opcode_decoder opcode_decoder_table;
+static_assert(opcode_decoder_table.unique, "two opcodes share a binary code");
+
+bool is_binary_program(const char *data, size_t size)
+{
+    return size >= 8 && std::memcmp(data, binary_magic, sizeof binary_magic) == 0;
+}
+
+binary_program::binary_program(const char *data, size_t size) : data_(data), size_(size)
+{
+    if (!is_binary_program(data, size) || size < 8 + sizeof(binary_trailer))
+        corrupt("missing header");
+    uint32_t v;
+    std::memcpy(&v, data + 4, sizeof v);
+    if (v != binary_version)
+        corrupt("version " + std::to_string(v) + ", expected " + std::to_string(binary_version));
+    if (reinterpret_cast<uintptr_t>(data) % 8 != 0 || size % 8 != 0)
+        corrupt("misaligned");
+
+    auto t = reinterpret_cast<const binary_trailer *>(data + size - sizeof(binary_trailer));
+    if (std::memcmp(t->magic, binary_magic, sizeof binary_magic) != 0)
+        corrupt("missing trailer");
+    auto in_bounds = [&](uint64_t off, uint64_t len)
+    { return off <= size && len <= size - off; };
+    if (!in_bounds(t->strings_offset, (t->n_strings + 1ull) * sizeof(uint32_t)) ||
+        !in_bounds(t->index_offset, t->n_functions * sizeof(binary_index_entry)) ||
+        !in_bounds(t->extra_offset, t->extra_len))
+        corrupt("tables out of bounds");
+
+    n_strings_ = t->n_strings;
+    string_offsets_ = reinterpret_cast<const uint32_t *>(data + t->strings_offset);
+    string_bytes_ = reinterpret_cast<const char *>(string_offsets_ + n_strings_ + 1);
+    if (!in_bounds(string_bytes_ - data, string_offsets_[n_strings_]))
+        corrupt("string table out of bounds");
+    for (uint32_t k = 0; k < n_strings_; ++k)
+    {
+        if (string_offsets_[k] > string_offsets_[k + 1])
+            corrupt("string table out of order");
+    }
+    n_functions_ = t->n_functions;
+    index_ = reinterpret_cast<const binary_index_entry *>(data + t->index_offset);
+    for (size_t f = 0; f < n_functions_; ++f)
+    {
+        if (!in_bounds(index_[f].offset, index_[f].size) || index_[f].offset % 8 != 0 ||
+            index_[f].size < sizeof(binary_func) || index_[f].name >= n_strings_)
+            corrupt("function " + std::to_string(f) + " out of bounds");
+    }
+    extra_ = std::string_view(data + t->extra_offset, t->extra_len);
+    syms_.assign(n_strings_, no_sym);
+}
+
+std::string_view binary_program::str(uint32_t id) const
+{
+    return std::string_view(string_bytes_ + string_offsets_[id], string_offsets_[id + 1] - string_offsets_[id]);
+}
+
+sym binary_program::symbol(uint32_t id) const
+{
+    if (id == no_sym)
+        return no_sym;
+    if (id >= n_strings_)
+        corrupt("string id " + std::to_string(id) + " out of range");
+    if (syms_[id] == no_sym)
+        syms_[id] = intern(str(id));
+    return syms_[id];
+}
+
+bril_function binary_program::function(size_t f) const
+{
+    const char *p = data_ + index_[f].offset;
+    const binary_func &h = *reinterpret_cast<const binary_func *>(p);
+    uint64_t need = sizeof(binary_func) + (uint64_t)h.n_instrs * sizeof(binary_instr) +
+                    (2ull * h.n_args + h.n_operands) * sizeof(uint32_t) + h.extras_len + h.extra_len;
+    if (need > index_[f].size)
+        corrupt("function " + std::to_string(f) + " overruns its record");
+
+    bril_function func;
+    func.name = symbol(h.name);
+    func.type = symbol(h.type);
+    func.has_args = h.has_args;
+
+    auto records = reinterpret_cast<const binary_instr *>(p + sizeof(binary_func));
+    auto ids = reinterpret_cast<const uint32_t *>(records + h.n_instrs);
+    func.args.resize(h.n_args);
+    for (uint32_t k = 0; k < h.n_args; ++k)
+        func.args[k] = {symbol(ids[2 * k]), symbol(ids[2 * k + 1])};
+    ids += 2 * h.n_args;
+    func.operands.resize(h.n_operands);
+    for (uint32_t k = 0; k < h.n_operands; ++k)
+        func.operands[k] = symbol(ids[k]);
+
+    const char *text = reinterpret_cast<const char *>(ids + h.n_operands);
+    if (h.extras_len)
+        func.extras = json::parse(text, text + h.extras_len).get<std::vector<json>>();
+    if (h.extra_len)
+        func.extra = json::parse(text + h.extras_len, text + h.extras_len + h.extra_len);
+
+    func.instrs.resize(h.n_instrs);
+    for (uint32_t k = 0; k < h.n_instrs; ++k)
+    {
+        const binary_instr &r = records[k];
+        instr &i = func.instrs[k];
+        uint8_t op = opcode_decoder_table.by_code[r.op];
+        if (op == no_opcode || r.literal_kind > literal::char_ ||
+            (uint64_t)r.args_off + r.args_len > h.n_operands || (uint64_t)r.funcs_off + r.funcs_len > h.n_operands ||
+            (uint64_t)r.labels_off + r.labels_len > h.n_operands || r.extra >= (int64_t)func.extras.size())
+            corrupt("bad instruction " + std::to_string(k) + " in function " + std::to_string(f));
+        i.op = (opcode)op;
+        i.present = r.present;
+        i.dest = symbol(r.dest);
+        i.type = symbol(r.type);
+        i.label = symbol(r.label);
+        i.args = {r.args_off, r.args_len};
+        i.funcs = {r.funcs_off, r.funcs_len};
+        i.labels = {r.labels_off, r.labels_len};
+        i.extra = r.extra;
+        i.value.kind = (literal::kind_t)r.literal_kind;
+        if (i.value.kind == literal::char_)
+            i.value.c = symbol(r.value);
+        else
+            i.value.u = r.value;
+    }
+    return func;
+}
+
+json binary_program::extra() const
+{
+    if (extra_.empty())
+        return json::object();
+    return json::parse(extra_.begin(), extra_.end());
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include "common.hpp"
+#include <iosfwd>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Binary form of the pass IR, for handing programs between tools without
+// text encoding. All integers are little-endian, and every record is 8-byte
+// aligned so a mapped file can be read in place. Layout:
+//
+//   "BRIL", u32 version
+//   function records, one after another
+//   string table:  u32 offsets[n_strings + 1], then the bytes
+//   function index: binary_index_entry[n_functions]
+//   program extras: json text
+//   binary_trailer
+//
+// Strings are numbered per file: names, labels, types and char literals in a
+// record are indices into the file's string table. The table and the index
+// come last so a writer can emit functions as it goes.
+
+constexpr char binary_magic[4] = {'B', 'R', 'I', 'L'};
+constexpr uint32_t binary_version = 1;
+
+// A function record is a binary_func header followed by n_instrs binary_instrs,
+// n_args (name, type) pairs, n_operands operand ids, then the json text of
+// the unmodelled fields (`extras_len` bytes of func.extras as an array,
+// `extra_len` bytes of func.extra), padded to 8 bytes.
+struct binary_func {
+    uint32_t name;
+    uint32_t type; // no_sym if none
+    uint32_t has_args;
+    uint32_t n_args;
+    uint32_t n_instrs;
+    uint32_t n_operands;
+    uint32_t extras_len;
+    uint32_t extra_len;
+};
+
+struct binary_instr {
+    uint8_t op; // opcode_code, not the enumerator's value
+    uint8_t present;
+    uint8_t literal_kind;
+    uint8_t pad0 = 0;
+    uint32_t dest;
+    uint32_t type;
+    uint32_t label;
+    uint32_t args_off, args_len;
+    uint32_t funcs_off, funcs_len;
+    uint32_t labels_off, labels_len;
+    int32_t extra;
+    uint32_t pad1 = 0;
+    uint64_t value; // literal bits; a char literal is a string index
+};
+
+struct binary_index_entry {
+    uint64_t offset; // of the binary_func, from the start of the file
+    uint64_t size;
+    uint32_t name;
+    uint32_t n_instrs;
+};
+
+struct binary_trailer {
+    uint64_t strings_offset;
+    uint64_t index_offset;
+    uint64_t extra_offset;
+    uint32_t n_strings;
+    uint32_t n_functions;
+    uint32_t extra_len;
+    char magic[4];
+};
+
+static_assert(sizeof(binary_func) == 32 && sizeof(binary_instr) == 56 && sizeof(binary_index_entry) == 24 &&
+                  sizeof(binary_trailer) == 40,
+              "binary records must not change size");
+
+// Writes the format one function at a time, like program_writer.
+class binary_writer {
+public:
+    explicit binary_writer(std::ostream& out);
+    void write_function(const bril_function& func);
+    void finish(const json& extra = json::object());
+
+private:
+    void start(); // the header, before the first record
+    uint32_t local(sym s);
+    void put(const void* p, size_t n);
+    void pad();
+
+    std::ostream& out_;
+    uint64_t written_ = 0;
+    std::unordered_map<sym, uint32_t> ids_;
+    std::vector<sym> strings_;
+    std::vector<binary_index_entry> index_;
+};
+
+void write_program_binary(std::ostream& out, const program& prog);
+
+// Read-only view of a program in the binary format, decoding functions on
+// request. Checks the header, trailer and table bounds up front and throws
+// std::runtime_error if they are off. `data` must stay alive and 8-byte
+// aligned (true of a mapping or a heap buffer). Not safe to decode from
+// several threads at once.
+class binary_program {
+public:
+    binary_program(const char* data, size_t size);
+
+    size_t size() const { return n_functions_; }
+    std::string_view function_name(size_t f) const { return str(index_[f].name); }
+    size_t function_instrs(size_t f) const { return index_[f].n_instrs; }
+    bril_function function(size_t f) const;
+    json extra() const;
+
+private:
+    std::string_view str(uint32_t id) const;
+    sym symbol(uint32_t id) const;
+
+    const char* data_;
+    size_t size_;
+    const uint32_t* string_offsets_;
+    const char* string_bytes_;
+    uint32_t n_strings_;
+    const binary_index_entry* index_;
+    uint32_t n_functions_;
+    std::string_view extra_;
+    mutable std::vector<sym> syms_; // file string id -> symbol, filled as ids are met
+};
+
+bool is_binary_program(const char* data, size_t size);
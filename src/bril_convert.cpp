@@ -0,0 +1,33 @@
+#include "bril_io.hpp"
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+// Converts between json, Bril's text syntax and the binary IR, one function
+// at a time.
+// usage: bril_convert [--indent N] [--text | --binary | --text-in | --text-out | --binary-in | --binary-out]
+//   e.g. bril_convert --binary-out < prog.json > prog.brb
+//        bril_convert --binary-in --indent 2 < prog.brb > prog.json
+// json is the default on either side; --indent applies to json output
+
+int main(int argc, char** argv) {
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    int indent = -1;
+    io_formats formats;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--indent") && i + 1 < argc && parse_number_flag(argv[i + 1], indent)) {
+            ++i;
+        } else if (!parse_format_flag(argv[i], formats)) {
+            cerr << "usage: " << argv[0] << " [--indent N] [--text | --binary | --text-in | --text-out | --binary-in | --binary-out]\n";
+            return 1;
+        }
+    }
+
+    format_writer writer(cout, indent, formats.out);
+    json extra = read_program_streaming(cin, formats, [&](bril_function& func) { writer.write_function(func); });
+    writer.finish(extra);
+    return 0;
+}
@@ -0,0 +1,399 @@
+#include "bril_io.hpp"
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool parse_format_flag(const std::string &arg, io_formats &formats)
+{
+    static const struct
+    {
+        const char *name;
+        io_format format;
+    } names[] = {{"text", io_format::text}, {"binary", io_format::binary}};
+
+    for (const auto &n : names)
+    {
+        std::string flag = std::string("--") + n.name;
+        if (arg == flag)
+            formats.in = formats.out = n.format;
+        else if (arg == flag + "-in")
+            formats.in = n.format;
+        else if (arg == flag + "-out")
+            formats.out = n.format;
+        else
+            continue;
+        return true;
+    }
+    return false;
+}
+
+template <typename T>
+static bool parse_number(const std::string &arg, T &out)
+{
+    T value;
+    const char *end = arg.data() + arg.size();
+    auto [ptr, ec] = std::from_chars(arg.data(), end, value);
+    if (arg.empty() || ec != std::errc() || ptr != end)
+        return false;
+    out = value;
+    return true;
+}
+
+bool parse_number_flag(const std::string &arg, int &out)
+{
+    return parse_number(arg, out);
+}
+
+bool parse_number_flag(const std::string &arg, unsigned &out)
+{
+    return parse_number(arg, out);
+}
+
+bool parse_number_flag(const std::string &arg, uint64_t &out)
+{
+    return parse_number(arg, out);
+}
+
+// ---------------------------------------------------------------------------
+// Input
+// ---------------------------------------------------------------------------
+
+bool input_bytes::mappable(std::istream &in)
+{
+    // only stdin, and only while nothing has been read from it
+    struct stat st;
+    return &in == &std::cin && fstat(STDIN_FILENO, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+           lseek(STDIN_FILENO, 0, SEEK_CUR) == 0;
+}
+
+input_bytes::input_bytes(std::istream &in)
+{
+    struct stat st;
+    if (mappable(in) && fstat(STDIN_FILENO, &st) == 0)
+    {
+        void *p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, STDIN_FILENO, 0);
+        if (p != MAP_FAILED)
+        {
+            data_ = static_cast<const char *>(p);
+            size_ = st.st_size;
+            mapped_ = true;
+            return;
+        }
+    }
+
+    std::string s((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    buffer_.reset(new uint64_t[s.size() / 8 + 1]);
+    std::memcpy(buffer_.get(), s.data(), s.size());
+    data_ = reinterpret_cast<const char *>(buffer_.get());
+    size_ = s.size();
+}
+
+input_bytes::~input_bytes()
+{
+    if (mapped_)
+        munmap(const_cast<char *>(data_), size_);
+}
+
+program read_program(std::istream &in, const io_formats &formats)
+{
+    if (formats.in == io_format::json)
+        return read_program(in);
+
+    input_bytes bytes(in);
+    if (formats.in == io_format::text)
+        return parse_bril_text(bytes.view());
+
+    binary_program bin(bytes.data(), bytes.size());
+    program prog;
+    prog.functions.reserve(bin.size());
+    for (size_t f = 0; f < bin.size(); ++f)
+        prog.functions.push_back(bin.function(f));
+    prog.extra = bin.extra();
+    return prog;
+}
+
+json read_program_streaming(std::istream &in, const io_formats &formats,
+                            const std::function<void(bril_function &)> &each)
+{
+    if (formats.in == io_format::json)
+        return read_program_streaming(in, each);
+
+    // the input stays mapped (or in memory); only one function is decoded
+    // at a time
+    input_bytes bytes(in);
+    if (formats.in == io_format::text)
+    {
+        read_bril_text(bytes.view(), each);
+        return json::object();
+    }
+
+    binary_program bin(bytes.data(), bytes.size());
+    for (size_t f = 0; f < bin.size(); ++f)
+    {
+        bril_function func = bin.function(f);
+        each(func);
+    }
+    return bin.extra();
+}
+
+// ---------------------------------------------------------------------------
+// Output
+// ---------------------------------------------------------------------------
+
+void write_program(std::ostream &out, const program &prog, int indent, const io_formats &formats)
+{
+    switch (formats.out)
+    {
+    case io_format::json: write_program(out, prog, indent); break;
+    case io_format::text: write_program_text(out, prog); break;
+    case io_format::binary: write_program_binary(out, prog); break;
+    }
+}
+
+format_writer::format_writer(std::ostream &out, int indent, io_format format)
+    : out_(out), format_(format), json_(out, indent), binary_(out)
+{
+}
+
+void format_writer::write_function(const bril_function &func)
+{
+    switch (format_)
+    {
+    case io_format::json: json_.write_function(func); break;
+    case io_format::text: write_function_text(out_, func); break;
+    case io_format::binary: binary_.write_function(func); break;
+    }
+}
+
+void format_writer::finish(const json &extra)
+{
+    if (format_ == io_format::json)
+        json_.finish(extra);
+    else if (format_ == io_format::binary)
+        binary_.finish(extra);
+}
+
+// ---------------------------------------------------------------------------
+// Lazy decoding
+// ---------------------------------------------------------------------------
+
+namespace
+{
+
+// Just enough of a json reader to find the elements of the top-level
+// "functions" array and their "name"s. Values are skipped, not parsed, and
+// malformed input is left for the real parser to report when the function
+// is decoded.
+class json_scanner
+{
+public:
+    explicit json_scanner(std::string_view s) : s_(s) {}
+
+    template <typename F>
+    void functions(F &&each)
+    {
+        if (!accept('{'))
+            fail();
+        while (!accept('}'))
+        {
+            accept(',');
+            std::string key = string();
+            if (!accept(':'))
+                fail();
+            if (key != "functions")
+            {
+                skip_value();
+                continue;
+            }
+            if (!accept('['))
+                fail();
+            while (!accept(']'))
+            {
+                accept(',');
+                skip_space();
+                size_t begin = pos_;
+                std::string name = function_name();
+                each(begin, std::move(name), pos_);
+            }
+        }
+    }
+
+private:
+    [[noreturn]] void fail()
+    {
+        throw std::runtime_error("bad json program near byte " + std::to_string(pos_));
+    }
+
+    void skip_space()
+    {
+        while (pos_ < s_.size() && (s_[pos_] == ' ' || s_[pos_] == '\t' || s_[pos_] == '\n' || s_[pos_] == '\r'))
+            ++pos_;
+    }
+
+    bool accept(char c)
+    {
+        skip_space();
+        if (pos_ >= s_.size() || s_[pos_] != c)
+            return false;
+        ++pos_;
+        return true;
+    }
+
+    // skips an object, returning its "name" if that is a string
+    std::string function_name()
+    {
+        std::string name;
+        if (!accept('{'))
+            fail();
+        while (!accept('}'))
+        {
+            accept(',');
+            std::string key = string();
+            if (!accept(':'))
+                fail();
+            skip_space();
+            if (key == "name" && pos_ < s_.size() && s_[pos_] == '"')
+                name = string();
+            else
+                skip_value();
+        }
+        return name;
+    }
+
+    std::string string()
+    {
+        skip_space();
+        size_t begin = pos_;
+        bool escaped = skip_string();
+        std::string_view raw = s_.substr(begin, pos_ - begin);
+        if (escaped)
+            return json::parse(raw).get<std::string>();
+        return std::string(raw.substr(1, raw.size() - 2));
+    }
+
+    // true if the string has escapes
+    bool skip_string()
+    {
+        if (pos_ >= s_.size() || s_[pos_] != '"')
+            fail();
+        bool escaped = false;
+        for (++pos_; pos_ < s_.size() && s_[pos_] != '"'; ++pos_)
+        {
+            if (s_[pos_] == '\\')
+            {
+                escaped = true;
+                ++pos_;
+            }
+        }
+        if (pos_ >= s_.size())
+            fail();
+        ++pos_;
+        return escaped;
+    }
+
+    void skip_value()
+    {
+        skip_space();
+        if (pos_ >= s_.size())
+            fail();
+        if (s_[pos_] == '"')
+        {
+            skip_string();
+            return;
+        }
+        if (s_[pos_] != '{' && s_[pos_] != '[')
+        {
+            // number, true, false or null
+            while (pos_ < s_.size() && !std::strchr(",}] \t\n\r", s_[pos_]))
+                ++pos_;
+            return;
+        }
+        int depth = 0;
+        do
+        {
+            if (pos_ >= s_.size())
+                fail();
+            char c = s_[pos_];
+            if (c == '"')
+            {
+                skip_string();
+                continue;
+            }
+            if (c == '{' || c == '[')
+                ++depth;
+            else if (c == '}' || c == ']')
+                --depth;
+            ++pos_;
+        } while (depth > 0);
+    }
+
+    std::string_view s_;
+    size_t pos_ = 0;
+};
+
+} // namespace
+
+lazy_program::lazy_program(const input_bytes &bytes, io_format format) : bytes_(bytes.view()), format_(format)
+{
+    switch (format)
+    {
+    case io_format::json:
+        json_scanner(bytes_).functions([&](size_t begin, std::string name, size_t end)
+                                       { funcs_.push_back({std::move(name), begin, end, end - begin}); });
+        break;
+    case io_format::text:
+        for (const auto &r : index_bril_text(bytes_))
+            funcs_.push_back({std::string(r.name), r.begin, r.end, r.end - r.begin});
+        break;
+    case io_format::binary:
+        binary_ = std::make_unique<binary_program>(bytes.data(), bytes.size());
+        for (size_t f = 0; f < binary_->size(); ++f)
+            funcs_.push_back({std::string(binary_->function_name(f)), f, f, binary_->function_instrs(f)});
+        break;
+    }
+}
+
+bril_function lazy_program::function(size_t f) const
+{
+    const range &r = funcs_[f];
+    std::string_view src = bytes_.substr(r.begin, r.end - r.begin);
+    switch (format_)
+    {
+    case io_format::json:
+        return function_from_json(json::parse(src.begin(), src.end()));
+    case io_format::text:
+        return parse_bril_text(src).functions.at(0);
+    case io_format::binary:
+        break;
+    }
+    return binary_->function(r.begin);
+}
+
+void function_filter::add(const std::string &pattern)
+{
+    names_.push_back(pattern);
+    try
+    {
+        patterns_.emplace_back(std::regex(pattern));
+    }
+    catch (const std::regex_error &)
+    {
+        patterns_.emplace_back(std::nullopt);
+    }
+}
+
+bool function_filter::matches(const std::string &name) const
+{
+    if (names_.empty())
+        return true;
+    for (size_t k = 0; k < names_.size(); ++k)
+    {
+        if (name == names_[k] || (patterns_[k] && std::regex_match(name, *patterns_[k])))
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include "bril_binary.hpp"
+#include "bril_text.hpp"
+#include <optional>
+#include <regex>
+#include <string>
+
+// The formats tools read and write: json (the default), Bril's text syntax
+// (bril_text.hpp) and the binary IR (bril_binary.hpp).
+enum class io_format : uint8_t { json, text, binary };
+
+struct io_formats {
+    io_format in = io_format::json;
+    io_format out = io_format::json;
+};
+
+// --text / --binary set both sides, --text-in, --binary-out etc. one side.
+// true if `arg` was one of these flags
+bool parse_format_flag(const std::string& arg, io_formats& formats);
+
+// The value of a numeric flag (-j N, --indent N, ...): true and set if all
+// of `arg` is a base-10 integer that fits, otherwise false with `out` left
+// alone, so "abc", "4x" and "-1" for a count end in the usage message.
+bool parse_number_flag(const std::string& arg, int& out);
+bool parse_number_flag(const std::string& arg, unsigned& out);
+bool parse_number_flag(const std::string& arg, uint64_t& out);
+
+// All of an input stream. For std::cin on a regular file (`tool < file`)
+// the file is mapped rather than read; otherwise it is read into memory.
+class input_bytes {
+public:
+    explicit input_bytes(std::istream& in);
+    ~input_bytes();
+    static bool mappable(std::istream& in); // would be mapped rather than read
+    input_bytes(const input_bytes&) = delete;
+    input_bytes& operator=(const input_bytes&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    std::string_view view() const { return {data_, size_}; }
+    bool mapped() const { return mapped_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool mapped_ = false;
+    std::unique_ptr<uint64_t[]> buffer_; // 8-byte aligned, for binary_program
+};
+
+// read_program / write_program / read_program_streaming in any format. Text
+// has no top-level fields, so streaming it returns an empty object.
+program read_program(std::istream& in, const io_formats& formats);
+void write_program(std::ostream& out, const program& prog, int indent, const io_formats& formats);
+json read_program_streaming(std::istream& in, const io_formats& formats,
+                            const std::function<void(bril_function&)>& each);
+
+// The functions of an input, located up front but decoded only when asked
+// for, so a tool that looks at a few functions of a big program only pays
+// for those. json and text are indexed by a scan that skips over function
+// bodies without building anything; binary input already has an index.
+// `bytes` must outlive the program.
+class lazy_program {
+public:
+    lazy_program(const input_bytes& bytes, io_format format);
+
+    size_t size() const { return funcs_.size(); }
+    const std::string& name(size_t f) const { return funcs_[f].name; }
+    size_t cost(size_t f) const { return funcs_[f].cost; } // instructions for binary, else bytes
+    bril_function function(size_t f) const;
+
+private:
+    struct range {
+        std::string name;
+        size_t begin, end;
+        size_t cost;
+    };
+
+    std::string_view bytes_;
+    io_format format_;
+    std::vector<range> funcs_;
+    std::unique_ptr<binary_program> binary_;
+};
+
+// --func patterns: a function is selected if its name equals one of them or
+// matches it as a regular expression; with no patterns every function is.
+// A pattern that is not a valid regular expression (Bril names may hold
+// brackets) only matches by name.
+class function_filter {
+public:
+    void add(const std::string& pattern);
+    bool empty() const { return names_.empty(); }
+    bool matches(const std::string& name) const;
+
+private:
+    std::vector<std::string> names_;
+    std::vector<std::optional<std::regex>> patterns_;
+};
+
+// program_writer for any output format.
+class format_writer {
+public:
+    format_writer(std::ostream& out, int indent, io_format format);
+    void write_function(const bril_function& func);
+    void finish(const json& extra = json::object());
+
+private:
+    std::ostream& out_;
+    io_format format_;
+    program_writer json_;
+    binary_writer binary_;
+};
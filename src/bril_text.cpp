@@ -0,0 +1,454 @@
+#include "bril_text.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// ---------------------------------------------------------------------------
+// Lexer: words are maximal runs of anything but whitespace and punctuation,
+// which covers identifiers, @funcs, .labels and numeric literals alike.
+// ---------------------------------------------------------------------------
+
+namespace
+{
+
+bool is_punct(char c)
+{
+    return std::strchr("{}():;=,<>#'", c) != nullptr;
+}
+
+bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+class text_parser
+{
+public:
+    explicit text_parser(std::string_view src) : src_(src) {}
+
+    void parse(const std::function<void(bril_function &)> &each)
+    {
+        for (skip_space(); pos_ < src_.size(); skip_space())
+        {
+            bril_function func = function();
+            each(func);
+        }
+    }
+
+    // finds each function's extent by scanning for its closing brace,
+    // stepping over comments and character literals
+    std::vector<text_function_range> index()
+    {
+        std::vector<text_function_range> out;
+        for (skip_space(); pos_ < src_.size(); skip_space())
+        {
+            text_function_range r;
+            r.begin = pos_;
+            r.name = sigil_word('@');
+            while (pos_ < src_.size() && src_[pos_] != '{')
+                ++pos_;
+            while (++pos_ < src_.size() && src_[pos_] != '}')
+            {
+                if (src_[pos_] == '#')
+                    pos_ = std::min(src_.find('\n', pos_), src_.size());
+                else if (src_[pos_] == '\'')
+                    pos_ = std::min(src_.find('\'', pos_ + 1), src_.size());
+            }
+            if (pos_ >= src_.size())
+                fail("unterminated function");
+            r.end = ++pos_;
+            out.push_back(r);
+        }
+        return out;
+    }
+
+private:
+    [[noreturn]] void fail(const std::string &what)
+    {
+        size_t line = 1 + std::count(src_.begin(), src_.begin() + std::min(pos_, src_.size()), '\n');
+        throw bril_syntax_error("line " + std::to_string(line) + ": " + what);
+    }
+
+    void skip_space()
+    {
+        while (pos_ < src_.size())
+        {
+            if (is_space(src_[pos_]))
+                ++pos_;
+            else if (src_[pos_] == '#')
+                while (pos_ < src_.size() && src_[pos_] != '\n')
+                    ++pos_;
+            else
+                break;
+        }
+    }
+
+    char peek()
+    {
+        skip_space();
+        return pos_ < src_.size() ? src_[pos_] : '\0';
+    }
+
+    bool accept(char c)
+    {
+        if (peek() != c)
+            return false;
+        ++pos_;
+        return true;
+    }
+
+    void expect(char c)
+    {
+        if (!accept(c))
+            fail(std::string("expected '") + c + "'");
+    }
+
+    std::string_view word()
+    {
+        skip_space();
+        size_t start = pos_;
+        while (pos_ < src_.size() && !is_space(src_[pos_]) && !is_punct(src_[pos_]))
+            ++pos_;
+        if (pos_ == start)
+            fail("expected a name");
+        return src_.substr(start, pos_ - start);
+    }
+
+    // the name after a one-character sigil, e.g. "f" for "@f"
+    std::string_view sigil_word(char sigil)
+    {
+        std::string_view w = word();
+        if (w[0] != sigil || w.size() < 2)
+            fail(std::string("expected '") + sigil + "name'");
+        return w.substr(1);
+    }
+
+    // ptr<int> is interned as {"ptr":"int"}, as type_from_json would
+    std::string type_text()
+    {
+        std::string_view base = word();
+        if (!accept('<'))
+            return std::string(base);
+        std::string inner = type_text();
+        expect('>');
+        std::string quoted_inner = inner[0] == '{' ? inner : json(inner).dump();
+        return "{" + json(std::string(base)).dump() + ":" + quoted_inner + "}";
+    }
+
+    sym type() { return intern(type_text()); }
+
+    bril_function function()
+    {
+        bril_function func;
+        func.name = intern(sigil_word('@'));
+        if (accept('('))
+        {
+            while (!accept(')'))
+            {
+                if (!func.args.empty())
+                    expect(',');
+                sym name = intern(word());
+                expect(':');
+                func.args.push_back({name, type()});
+            }
+            func.has_args = !func.args.empty();
+        }
+        if (accept(':'))
+            func.type = type();
+        expect('{');
+        while (!accept('}'))
+        {
+            if (pos_ >= src_.size())
+                fail("unterminated function");
+            instruction(func);
+        }
+        return func;
+    }
+
+    void instruction(bril_function &func)
+    {
+        std::string_view first = word();
+        instr i;
+        if (first[0] == '.' && accept(':'))
+        {
+            i.op = opcode::label;
+            i.label = intern(first.substr(1));
+            func.instrs.push_back(i);
+            return;
+        }
+
+        std::string_view op = first;
+        if (peek() == ':' || peek() == '=')
+        {
+            i.dest = intern(first);
+            if (accept(':'))
+                i.type = type();
+            expect('=');
+            op = word();
+        }
+
+        if (op == "const")
+        {
+            i.op = opcode::const_;
+            literal_value(i.value);
+            expect(';');
+            func.instrs.push_back(i);
+            return;
+        }
+
+        i.op = opcode_from_name(std::string(op));
+        if (i.op == opcode::unknown)
+        {
+            i.extra = (int32_t)func.extras.size();
+            func.extras.push_back({{"op", std::string(op)}});
+        }
+
+        // @funcs, .labels and plain args may come in any order; bril2json
+        // keeps each kind in order and omits the empty ones
+        std::vector<sym> args, funcs, labels;
+        while (!accept(';'))
+        {
+            if (pos_ >= src_.size())
+                fail("expected ';'");
+            std::string_view w = word();
+            if (w[0] == '@' && w.size() > 1)
+                funcs.push_back(intern(w.substr(1)));
+            else if (w[0] == '.' && w.size() > 1)
+                labels.push_back(intern(w.substr(1)));
+            else
+                args.push_back(intern(w));
+        }
+        if (!args.empty())
+        {
+            i.args = func.add_operands(args);
+            i.present |= instr::HAS_ARGS;
+        }
+        if (!funcs.empty())
+        {
+            i.funcs = func.add_operands(funcs);
+            i.present |= instr::HAS_FUNCS;
+        }
+        if (!labels.empty())
+        {
+            i.labels = func.add_operands(labels);
+            i.present |= instr::HAS_LABELS;
+        }
+        func.instrs.push_back(i);
+    }
+
+    // same literal kinds as the json path: non-negative integers are unsigned
+    void literal_value(literal &lit)
+    {
+        if (accept('\''))
+        {
+            size_t start = pos_;
+            while (pos_ < src_.size() && src_[pos_] != '\'')
+                ++pos_;
+            if (pos_ >= src_.size())
+                fail("unterminated character literal");
+            lit.kind = literal::char_;
+            lit.c = intern(src_.substr(start, pos_ - start));
+            ++pos_;
+            return;
+        }
+
+        std::string_view w = word();
+        const char *first = w.data(), *last = w.data() + w.size();
+        if (w == "true" || w == "false")
+        {
+            lit.kind = literal::bool_;
+            lit.b = w == "true";
+        }
+        else if (w.find_first_of(".eE") != std::string_view::npos || w == "inf" || w == "-inf" || w == "nan")
+        {
+            lit.kind = literal::float_;
+            lit.f = std::strtod(std::string(w).c_str(), nullptr);
+        }
+        else if (w[0] == '-')
+        {
+            lit.kind = literal::int_;
+            if (std::from_chars(first, last, lit.i).ptr != last)
+                fail("bad integer literal '" + std::string(w) + "'");
+        }
+        else
+        {
+            lit.kind = literal::uint_;
+            if (std::from_chars(first + (w[0] == '+'), last, lit.u).ptr != last)
+                fail("bad integer literal '" + std::string(w) + "'");
+        }
+    }
+
+    std::string_view src_;
+    size_t pos_ = 0;
+};
+
+} // namespace
+
+void read_bril_text(std::string_view src, const std::function<void(bril_function &)> &each)
+{
+    text_parser(src).parse(each);
+}
+
+std::vector<text_function_range> index_bril_text(std::string_view src)
+{
+    return text_parser(src).index();
+}
+
+program parse_bril_text(std::string_view src)
+{
+    program prog;
+    read_bril_text(src, [&](bril_function &func)
+                   { prog.functions.push_back(std::move(func)); });
+    return prog;
+}
+
+// ---------------------------------------------------------------------------
+// Printer
+// ---------------------------------------------------------------------------
+
+static void put_type(std::ostream &out, const json &t)
+{
+    if (t.is_object() && t.size() == 1)
+    {
+        out << t.begin().key() << "<";
+        put_type(out, t.begin().value());
+        out << ">";
+    }
+    else if (t.is_string())
+        out << t.get<std::string>();
+    else
+        out << t.dump();
+}
+
+static void put_type(std::ostream &out, sym t)
+{
+    const std::string &s = sym_name(t);
+    if (!s.empty() && s[0] == '{')
+        put_type(out, json::parse(s));
+    else
+        out << s;
+}
+
+// Python's repr(), which is what bril2txt prints: shortest round-trip
+// digits, positional for exponents in [-4, 16), and always a '.' or 'e'
+static std::string float_repr(double d)
+{
+    if (std::isnan(d))
+        return "nan";
+    if (std::isinf(d))
+        return d < 0 ? "-inf" : "inf";
+    char buf[64];
+    char *end = std::to_chars(buf, buf + sizeof buf, d, std::chars_format::scientific).ptr;
+    std::string_view s(buf, end - buf);
+    size_t e_at = s.find('e');
+    int exp = std::atoi(std::string(s.substr(e_at + 1)).c_str());
+    std::string sign = s[0] == '-' ? "-" : "";
+    std::string digits;
+    for (char c : s.substr(sign.size(), e_at - sign.size()))
+        if (c != '.')
+            digits += c;
+
+    if (exp >= -4 && exp < 16)
+    {
+        int point = exp + 1; // digits before the decimal point
+        if (point <= 0)
+            return sign + "0." + std::string(-point, '0') + digits;
+        if ((size_t)point >= digits.size())
+            return sign + digits + std::string(point - digits.size(), '0') + ".0";
+        return sign + digits.substr(0, point) + "." + digits.substr(point);
+    }
+    std::string mantissa = digits.substr(0, 1) + (digits.size() > 1 ? "." + digits.substr(1) : "");
+    char e[16];
+    std::snprintf(e, sizeof e, "e%c%02d", exp < 0 ? '-' : '+', std::abs(exp));
+    return sign + mantissa + e;
+}
+
+static void put_literal(std::ostream &out, const literal &lit)
+{
+    switch (lit.kind)
+    {
+    case literal::int_: out << lit.i; break;
+    case literal::uint_: out << lit.u; break;
+    case literal::float_: out << float_repr(lit.f); break;
+    case literal::bool_: out << (lit.b ? "true" : "false"); break;
+    case literal::char_: out << "'" << sym_name(lit.c) << "'"; break;
+    default: out << "null";
+    }
+}
+
+static std::string op_text(const bril_function &func, const instr &i)
+{
+    if (i.op != opcode::unknown)
+        return opcode_name(i.op);
+    if (i.extra >= 0)
+    {
+        const json &extra = func.extras[i.extra];
+        auto it = extra.find("op");
+        if (it != extra.end() && it->is_string())
+            return it->get<std::string>();
+    }
+    return "nop";
+}
+
+void write_function_text(std::ostream &out, const bril_function &func)
+{
+    out << "@" << sym_name(func.name);
+    if (!func.args.empty())
+    {
+        out << "(";
+        for (size_t k = 0; k < func.args.size(); ++k)
+        {
+            out << (k ? ", " : "") << sym_name(func.args[k].name) << ": ";
+            put_type(out, func.args[k].type);
+        }
+        out << ")";
+    }
+    if (func.type != no_sym)
+    {
+        out << ": ";
+        put_type(out, func.type);
+    }
+    out << " {\n";
+
+    for (const instr &i : func.instrs)
+    {
+        if (i.is_label())
+        {
+            out << "." << sym_name(i.label) << ":\n";
+            continue;
+        }
+        out << "  ";
+        if (i.has_dest())
+        {
+            out << sym_name(i.dest);
+            if (i.type != no_sym)
+            {
+                out << ": ";
+                put_type(out, i.type);
+            }
+            out << " = ";
+        }
+        out << op_text(func, i);
+        if (i.value.kind != literal::none)
+        {
+            out << " ";
+            put_literal(out, i.value);
+        }
+        for (sym f : func.funcs_of(i))
+            out << " @" << sym_name(f);
+        for (sym a : func.args_of(i))
+            out << " " << sym_name(a);
+        for (sym l : func.labels_of(i))
+            out << " ." << sym_name(l);
+        out << ";\n";
+    }
+    out << "}\n";
+}
+
+void write_program_text(std::ostream &out, const program &prog)
+{
+    for (const auto &func : prog.functions)
+        write_function_text(out, func);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "common.hpp"
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+
+// Bril's textual syntax, as printed by bril2txt and read by bril2json, so
+// tools can take .bril files directly. The lexer works in place on the
+// source text and interns names straight from it. Parsing gives the same
+// IR as bril2json followed by read_program.
+//
+// Not supported: imports and struct declarations.
+
+struct bril_syntax_error : std::runtime_error {
+    using std::runtime_error::runtime_error;
+};
+
+// Calls `each` on every function in order; throws bril_syntax_error with the
+// line number on malformed input.
+void read_bril_text(std::string_view src, const std::function<void(bril_function&)>& each);
+program parse_bril_text(std::string_view src);
+
+// Where each function is in `src`, without parsing the bodies; parsing
+// src.substr(begin, end - begin) gives just that function.
+struct text_function_range {
+    std::string_view name;
+    size_t begin, end;
+};
+std::vector<text_function_range> index_bril_text(std::string_view src);
+
+// bril2txt's format. Fields the text has no syntax for (e.g. "pos") are
+// dropped.
+void write_function_text(std::ostream& out, const bril_function& func);
+void write_program_text(std::ostream& out, const program& prog);
@@ -1,58 +1,706 @@
 #include "common.hpp"
 #include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <mutex>
 
-bool has_dest(const json &instr)
+// ---------------------------------------------------------------------------
+// Symbols
+// ---------------------------------------------------------------------------
+
+sym symbol_table::intern(std::string_view s)
+{
+    {
+        std::shared_lock<std::shared_mutex> read(lock_);
+        auto it = ids_.find(s);
+        if (it != ids_.end())
+            return it->second;
+    }
+    std::unique_lock<std::shared_mutex> write(lock_);
+    auto it = ids_.find(s); // another thread may have added it meanwhile
+    if (it != ids_.end())
+        return it->second;
+    size_t id = size_.load(std::memory_order_relaxed);
+    uint64_t v = id + first_chunk;
+    int k = 63 - __builtin_clzll(v) - first_chunk_bits;
+    if (!chunks_[k])
+        chunks_[k].reset(new std::string[first_chunk << k]);
+    std::string &name = chunks_[k][v - (first_chunk << k)];
+    name.assign(s);
+    ids_.emplace(name, (sym)id);
+    size_.store(id + 1, std::memory_order_release);
+    return (sym)id;
+}
+
+void symbol_table::clear()
+{
+    std::unique_lock<std::shared_mutex> write(lock_);
+    ids_.clear();
+    // the first chunk is small and always needed again
+    for (int k = 1; k < max_chunks; ++k)
+        chunks_[k].reset();
+    size_t n = std::min<size_t>(size_.load(std::memory_order_relaxed), first_chunk);
+    for (size_t i = 0; i < n; ++i)
+        std::string().swap(chunks_[0][i]);
+    size_.store(0, std::memory_order_release);
+}
+
+symbol_table &symbols()
+{
+    static symbol_table table;
+    return table;
+}
+
+// ---------------------------------------------------------------------------
+// Arenas
+// ---------------------------------------------------------------------------
+
+namespace
+{
+thread_local function_arena *current_arena = nullptr;
+std::atomic<bool> use_arenas{true};
+
+// every block starts with the arena it came from (nullptr for the heap),
+// padded so the caller's part stays 16-byte aligned
+constexpr size_t arena_header = function_arena::granule;
+} // namespace
+
+arena_blocks::~arena_blocks()
+{
+    for (const kept &b : kept_)
+        ::operator delete(b.p, b.bytes, std::align_val_t(b.align));
+}
+
+void *arena_blocks::do_allocate(size_t bytes, size_t align)
+{
+    for (size_t i = 0; i < kept_.size(); ++i)
+        if (kept_[i].bytes == bytes && kept_[i].align == align)
+        {
+            void *p = kept_[i].p;
+            kept_bytes_ -= bytes;
+            kept_[i] = kept_.back();
+            kept_.pop_back();
+            return p;
+        }
+    return ::operator new(bytes, std::align_val_t(align));
+}
+
+void arena_blocks::do_deallocate(void *p, size_t bytes, size_t align)
+{
+    if (kept_bytes_ + bytes <= keep_limit)
+    {
+        kept_.push_back({p, bytes, align});
+        kept_bytes_ += bytes;
+    }
+    else
+        ::operator delete(p, bytes, std::align_val_t(align));
+}
+
+void function_arena::reset()
+{
+    bump_.release();
+    std::fill(std::begin(free_), std::end(free_), nullptr);
+    allocations_ = 0;
+    bytes_ = 0;
+}
+
+arena_scope::arena_scope(function_arena &arena) : saved_(current_arena)
+{
+    current_arena = use_arenas.load(std::memory_order_relaxed) ? &arena : nullptr;
+}
+
+arena_scope::~arena_scope()
+{
+    current_arena = saved_;
+}
+
+namespace
+{
+thread_local std::unique_ptr<function_arena> thread_arena;
+thread_local bool thread_arena_busy = false;
+} // namespace
+
+thread_arena_scope::thread_arena_scope()
+{
+    if (thread_arena_busy)
+    {
+        nested_ = std::make_unique<function_arena>();
+        arena_ = nested_.get();
+    }
+    else
+    {
+        if (!thread_arena)
+            thread_arena = std::make_unique<function_arena>();
+        thread_arena_busy = true;
+        arena_ = thread_arena.get();
+        arena_->reset();
+    }
+    scope_.emplace(*arena_);
+}
+
+thread_arena_scope::~thread_arena_scope()
+{
+    scope_.reset();
+    if (!nested_)
+        thread_arena_busy = false;
+}
+
+void set_arenas_enabled(bool on)
+{
+    use_arenas.store(on, std::memory_order_relaxed);
+}
+
+bool arenas_enabled()
+{
+    return use_arenas.load(std::memory_order_relaxed);
+}
+
+static size_t arena_block_size(size_t bytes)
+{
+    return (bytes + arena_header + function_arena::granule - 1) & ~(function_arena::granule - 1);
+}
+
+void *arena_allocate(size_t bytes)
+{
+    function_arena *arena = current_arena;
+    void *p = arena ? arena->allocate(arena_block_size(bytes)) : ::operator new(bytes + arena_header);
+    *static_cast<function_arena **>(p) = arena;
+    return static_cast<char *>(p) + arena_header;
+}
+
+void arena_deallocate(void *p, size_t bytes)
+{
+    void *base = static_cast<char *>(p) - arena_header;
+    if (function_arena *arena = *static_cast<function_arena **>(base))
+        arena->deallocate(base, arena_block_size(bytes));
+    else
+        ::operator delete(base);
+}
+
+// ---------------------------------------------------------------------------
+// Opcodes and literals
+// ---------------------------------------------------------------------------
+
+opcode opcode_from_name(const std::string &name)
+{
+    static const std::unordered_map<std::string, opcode> by_name = []
+    {
+        std::unordered_map<std::string, opcode> m;
+        // "label" and "unknown" are not real Bril ops
+        for (size_t i = 1; i < (size_t)opcode::unknown; ++i)
+            m.emplace(opcode_name((opcode)i), (opcode)i);
+        return m;
+    }();
+    auto it = by_name.find(name);
+    return it == by_name.end() ? opcode::unknown : it->second;
+}
+
+bool literal::operator==(const literal &other) const
+{
+    if (kind != other.kind)
+        return false;
+    switch (kind)
+    {
+    case int_:
+        return i == other.i;
+    case uint_:
+        return u == other.u;
+    case float_:
+        return f == other.f;
+    case bool_:
+        return b == other.b;
+    case char_:
+        return c == other.c;
+    default:
+        return true;
+    }
+}
+
+bool literal::operator<(const literal &other) const
+{
+    if (kind != other.kind)
+        return kind < other.kind;
+    switch (kind)
+    {
+    case int_:
+        return i < other.i;
+    case uint_:
+        return u < other.u;
+    case float_:
+        return f < other.f;
+    case bool_:
+        return b < other.b;
+    case char_:
+        return c < other.c;
+    default:
+        return false;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// json import/export
+// ---------------------------------------------------------------------------
+
+// Plain types are interned as-is; parameterized types (e.g. {"ptr": "int"})
+// are interned as their compact json so they still fit in one symbol.
+static sym type_from_json(const json &t)
+{
+    return t.is_string() ? intern(t.get<std::string>()) : intern(t.dump());
+}
+
+template <typename J>
+static J type_to_json(sym t)
+{
+    const std::string &s = sym_name(t);
+    return (!s.empty() && s[0] == '{') ? J::parse(s) : J(s);
+}
+
+static bool literal_from_json(const json &v, literal &lit)
+{
+    if (v.is_boolean())
+    {
+        lit.kind = literal::bool_;
+        lit.b = v.get<bool>();
+    }
+    else if (v.is_number_unsigned())
+    {
+        lit.kind = literal::uint_;
+        lit.u = v.get<uint64_t>();
+    }
+    else if (v.is_number_integer())
+    {
+        lit.kind = literal::int_;
+        lit.i = v.get<int64_t>();
+    }
+    else if (v.is_number_float())
+    {
+        lit.kind = literal::float_;
+        lit.f = v.get<double>();
+    }
+    else if (v.is_string())
+    {
+        lit.kind = literal::char_;
+        lit.c = intern(v.get<std::string>());
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+template <typename J>
+static J literal_to_json(const literal &lit)
+{
+    switch (lit.kind)
+    {
+    case literal::int_:
+        return lit.i;
+    case literal::uint_:
+        return lit.u;
+    case literal::float_:
+        return lit.f;
+    case literal::bool_:
+        return lit.b;
+    case literal::char_:
+        return sym_name(lit.c);
+    default:
+        return nullptr;
+    }
+}
+
+operand_list bril_function::add_operands(const sym *first, size_t n)
+{
+    operand_list l;
+    l.off = (uint32_t)operands.size();
+    l.len = (uint32_t)n;
+    operands.insert(operands.end(), first, first + n);
+    return l;
+}
+
+sym bril_function::synthetic_label(size_t idx) const
+{
+    if (idx >= synthetic_labels_.size())
+        synthetic_labels_.resize(idx + 1, no_sym);
+    sym &label = synthetic_labels_[idx];
+    if (label == no_sym)
+        label = intern(sym_name(name) + "-block" + std::to_string(idx));
+    return label;
+}
+
+static bool names_from_json(bril_function &func, const json &arr, operand_list &out)
+{
+    if (!arr.is_array())
+        return false;
+    out.off = (uint32_t)func.operands.size();
+    for (const auto &a : arr)
+    {
+        if (!a.is_string())
+        {
+            func.operands.resize(out.off);
+            return false;
+        }
+        func.operands.push_back(intern(a.get<std::string>()));
+    }
+    out.len = (uint32_t)(func.operands.size() - out.off);
+    return true;
+}
+
+static instr instr_from_json(bril_function &func, const json &j)
+{
+    instr i;
+    i.op = opcode::unknown;
+    json rest = json::object();
+
+    if (j.contains("label") && j["label"].is_string())
+    {
+        i.op = opcode::label;
+        i.label = intern(j["label"].get<std::string>());
+    }
+
+    for (const auto &[key, v] : j.items())
+    {
+        bool ok = true;
+        if (key == "label")
+            ok = i.is_label();
+        else if (key == "op")
+        {
+            opcode op = v.is_string() ? opcode_from_name(v.get<std::string>()) : opcode::unknown;
+            ok = !i.is_label() && op != opcode::unknown;
+            if (ok)
+                i.op = op;
+        }
+        else if (key == "dest")
+        {
+            ok = v.is_string();
+            if (ok)
+                i.dest = intern(v.get<std::string>());
+        }
+        else if (key == "type")
+            i.type = type_from_json(v);
+        else if (key == "args")
+        {
+            ok = names_from_json(func, v, i.args);
+            if (ok)
+                i.present |= instr::HAS_ARGS;
+        }
+        else if (key == "funcs")
+        {
+            ok = names_from_json(func, v, i.funcs);
+            if (ok)
+                i.present |= instr::HAS_FUNCS;
+        }
+        else if (key == "labels")
+        {
+            ok = names_from_json(func, v, i.labels);
+            if (ok)
+                i.present |= instr::HAS_LABELS;
+        }
+        else if (key == "value")
+            ok = literal_from_json(v, i.value);
+        else
+            ok = false;
+
+        if (!ok)
+            rest[key] = v;
+    }
+
+    if (!rest.empty())
+    {
+        i.extra = (int32_t)func.extras.size();
+        func.extras.push_back(std::move(rest));
+    }
+    return i;
+}
+
+template <typename J>
+static J names_to_json(const id_span<const sym> &names)
+{
+    J arr = J::array();
+    for (sym s : names)
+        arr.push_back(sym_name(s));
+    return arr;
+}
+
+template <typename J>
+J instr_to_json(const bril_function &func, const instr &i)
+{
+    J j = J::object();
+    if (i.is_label())
+        j["label"] = sym_name(i.label);
+    else if (i.op != opcode::unknown)
+        j["op"] = opcode_name(i.op);
+    if (i.dest != no_sym)
+        j["dest"] = sym_name(i.dest);
+    if (i.type != no_sym)
+        j["type"] = type_to_json<J>(i.type);
+    if (i.present & instr::HAS_ARGS)
+        j["args"] = names_to_json<J>(func.args_of(i));
+    if (i.present & instr::HAS_FUNCS)
+        j["funcs"] = names_to_json<J>(func.funcs_of(i));
+    if (i.present & instr::HAS_LABELS)
+        j["labels"] = names_to_json<J>(func.labels_of(i));
+    if (i.value.kind != literal::none)
+        j["value"] = literal_to_json<J>(i.value);
+    if (i.extra >= 0)
+    {
+        for (const auto &[key, v] : func.extras[i.extra].items())
+            j[key] = v;
+    }
+    return j;
+}
+
+bril_function function_from_json(const json &j)
+{
+    bril_function func;
+    for (const auto &[key, v] : j.items())
+    {
+        if (key == "name" && v.is_string())
+            func.name = intern(v.get<std::string>());
+        else if (key == "type")
+            func.type = type_from_json(v);
+        else if (key == "args" && v.is_array())
+        {
+            func.has_args = true;
+            for (const auto &a : v)
+                func.args.push_back({intern(a.at("name").get<std::string>()), type_from_json(a.at("type"))});
+        }
+        else if (key == "instrs" && v.is_array())
+        {
+            func.instrs.reserve(v.size());
+            func.operands.reserve(v.size() * 2);
+            for (const auto &instr_json : v)
+                func.instrs.push_back(instr_from_json(func, instr_json));
+        }
+        else
+            func.extra[key] = v;
+    }
+    return func;
+}
+
+template <typename J>
+J function_to_json(const bril_function &func)
 {
-    return instr.contains("dest") && instr["dest"].is_string();
+    J j = func.extra;
+    if (func.name != no_sym)
+        j["name"] = sym_name(func.name);
+    if (func.type != no_sym)
+        j["type"] = type_to_json<J>(func.type);
+    if (func.has_args)
+    {
+        J args = J::array();
+        for (const auto &a : func.args)
+            args.push_back({{"name", sym_name(a.name)}, {"type", type_to_json<J>(a.type)}});
+        j["args"] = std::move(args);
+    }
+    J instrs = J::array();
+    instrs.template get_ref<typename J::array_t &>().reserve(func.instrs.size());
+    for (const auto &i : func.instrs)
+        instrs.push_back(instr_to_json<J>(func, i));
+    j["instrs"] = std::move(instrs);
+    return j;
 }
 
-std::vector<std::string> get_args(const json &instr)
+template json function_to_json<json>(const bril_function &);
+template arena_json function_to_json<arena_json>(const bril_function &);
+template json instr_to_json<json>(const bril_function &, const instr &);
+template arena_json instr_to_json<arena_json>(const bril_function &, const instr &);
+
+program program_from_json(const json &j)
 {
-    std::vector<std::string> out;
-    if (instr.contains("args") && instr["args"].is_array())
+    program prog;
+    for (const auto &[key, v] : j.items())
     {
-        out.reserve(instr["args"].size());
-        for (const auto &a : instr["args"])
-            out.push_back(a.get<std::string>());
+        if (key == "functions")
+        {
+            prog.functions.reserve(v.size());
+            for (const auto &f : v)
+                prog.functions.push_back(function_from_json(f));
+        }
+        else
+            prog.extra[key] = v;
     }
+    return prog;
+}
+
+json program_to_json(const program &prog)
+{
+    json j = prog.extra;
+    json funcs = json::array();
+    for (const auto &f : prog.functions)
+        funcs.push_back(function_to_json(f));
+    j["functions"] = std::move(funcs);
+    return j;
+}
+
+program read_program(std::istream &in)
+{
+    std::string input((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+#ifdef BRIL_SIMD_JSON
+    return read_program_simd(input);
+#else
+    return program_from_json(json::parse(input));
+#endif
+}
+
+void write_program(std::ostream &out, const program &prog, int indent)
+{
+#ifdef BRIL_SIMD_JSON
+    if (indent < 0)
+    {
+        write_program_compact(out, prog);
+        return;
+    }
+#endif
+    out << program_to_json(prog).dump(indent) << "\n";
+}
+
+json read_program_streaming(std::istream &in, const std::function<void(bril_function &)> &each)
+{
+    bool in_functions = false;
+    auto cb = [&](int depth, json::parse_event_t event, json &parsed)
+    {
+        if (depth == 1 && event == json::parse_event_t::key)
+            in_functions = parsed == "functions";
+        if (depth == 2 && in_functions && event == json::parse_event_t::object_end)
+        {
+            bril_function func = function_from_json(parsed);
+            parsed = nullptr;
+            each(func);
+            return false; // drop it from the (otherwise empty) top-level DOM
+        }
+        return true;
+    };
+    json j = json::parse(in, cb);
+    j.erase("functions");
+    return j;
+}
+
+void program_writer::newline(int level)
+{
+    if (indent_ >= 0)
+        out_ << '\n' << std::string(level * indent_, ' ');
+}
+
+// v.dump() re-indented to sit `level` deep, as in a dump of the whole program
+template <typename J>
+void program_writer::write_value(const J &v, int level)
+{
+    std::string s = v.dump(indent_);
+    if (indent_ > 0)
+    {
+        std::string pad(level * indent_, ' ');
+        size_t start = 0;
+        for (size_t nl; (nl = s.find('\n', start)) != std::string::npos; start = nl + 1)
+            out_.write(s.data() + start, nl + 1 - start) << pad;
+        out_.write(s.data() + start, s.size() - start);
+    }
+    else
+        out_ << s;
+}
+
+void program_writer::write_key(const std::string &key)
+{
+    newline(1);
+    out_ << json(key).dump() << (indent_ >= 0 ? ": " : ":");
+}
+
+void program_writer::write_function(const bril_function &func)
+{
+    if (written_++ == 0)
+    {
+        out_ << "{";
+        write_key("functions");
+        out_ << "[";
+    }
+    else
+        out_ << ",";
+    newline(2);
+    write_value(function_to_json<arena_json>(func), 2);
+}
+
+void program_writer::finish(const json &extra)
+{
+    if (written_ == 0)
+    {
+        out_ << "{";
+        write_key("functions");
+        out_ << "[]";
+    }
+    else
+    {
+        newline(1);
+        out_ << "]";
+    }
+    for (const auto &[key, v] : extra.items())
+    {
+        out_ << ",";
+        write_key(key);
+        write_value(v, 1);
+    }
+    newline(0);
+    out_ << "}\n";
+}
+
+std::vector<sym> func_arg_names(const bril_function &func)
+{
+    std::vector<sym> out;
+    out.reserve(func.args.size());
+    for (const auto &a : func.args)
+        out.push_back(a.name);
     return out;
 }
 
-std::vector<std::vector<json>> gen_basic_blocks(const json &function)
+// ---------------------------------------------------------------------------
+// Basic blocks and CFG
+// ---------------------------------------------------------------------------
+
+bool has_dest(const instr &i)
 {
-    std::vector<std::vector<json>> basic_blocks;
-    std::vector<json> curr_block;
+    return i.has_dest();
+}
+
+std::vector<sym> get_args(const bril_function &func, const instr &i)
+{
+    auto args = func.args_of(i);
+    return std::vector<sym>(args.begin(), args.end());
+}
+
+std::vector<block> gen_basic_blocks(const bril_function &func)
+{
+    std::vector<block> basic_blocks;
+    block curr_block;
     bool skip_until_label = false;  // Skip unreachable code after terminators
 
-    for (const auto &instr : function.at("instrs"))
+    for (uint32_t k = 0; k < func.instrs.size(); ++k)
     {
-        bool has_label = instr.contains("label");
-        bool has_op = instr.contains("op");
-        bool is_term = has_op && (instr.at("op") == "br" || instr.at("op") == "jmp" || instr.at("op") == "ret");
-
-        if (has_label)
+        const instr &instr = func.instrs[k];
+        if (instr.is_label())
         {
             skip_until_label = false;  // Reset skip flag when we hit a label
             if (!curr_block.empty())
                 basic_blocks.push_back(curr_block);
-            curr_block.clear();
-            curr_block.push_back(instr);
+            curr_block = {k, k + 1};
         }
         else if (skip_until_label)
         {
             // Skip unreachable instructions after a terminator
             continue;
         }
-        else if (is_term)
+        else if (is_terminator(instr.op))
         {
-            curr_block.push_back(instr);
+            if (curr_block.empty())
+                curr_block.begin = k;
+            curr_block.end = k + 1;
             basic_blocks.push_back(curr_block);
-            curr_block.clear();
+            curr_block = {};
             skip_until_label = true;  // Skip any instructions until next label
         }
         else
         {
-            curr_block.push_back(instr);
+            if (curr_block.empty())
+                curr_block.begin = k;
+            curr_block.end = k + 1;
         }
     }
     if (!curr_block.empty())
@@ -60,142 +708,322 @@ std::vector<std::vector<json>> gen_basic_blocks(const json &function)
     return basic_blocks;
 }
 
-cfg_info build_cfg(const std::string &func_name, const std::vector<std::vector<json>> &basic_blocks)
+void block_rewrite::erase(uint32_t at)
 {
-    cfg_info cfg;
+    if (at >= erased_.size())
+        erased_.resize(at + 1);
+    erased_[at] = true;
+    any_erased_ = true;
+}
+
+void rebuild_blocks(bril_function &func, std::vector<block> &blocks, block_rewrite edits)
+{
+    auto &inserts = edits.inserts_;
+    if (inserts.empty())
+    {
+        // blocks are in instruction order, so nothing is written past
+        // where it is read
+        uint32_t out = 0;
+        for (block &b : blocks)
+        {
+            uint32_t begin = out;
+            for (uint32_t k = b.begin; k < b.end; ++k)
+            {
+                if (!edits.erased(k))
+                    func.instrs[out++] = func.instrs[k];
+            }
+            b = {begin, out};
+        }
+        func.instrs.resize(out);
+        return;
+    }
 
-    // Initialize all labels in both maps
-    for (size_t i = 0; i < basic_blocks.size(); ++i)
+    std::stable_sort(inserts.begin(), inserts.end(), [](const auto &x, const auto &y)
+                     { return x.b != y.b ? x.b < y.b : x.before < y.before; });
+    std::vector<instr> instrs;
+    instrs.reserve(func.instrs.size() + inserts.size());
+    auto next = inserts.begin();
+    for (block_id id = 0; id < blocks.size(); ++id)
     {
-        std::string label = get_label(basic_blocks, func_name, i);
-        cfg.successors[label] = std::vector<std::string>();
-        cfg.predecessors[label] = std::vector<std::string>();
+        block &b = blocks[id];
+        uint32_t begin = (uint32_t)instrs.size();
+        for (uint32_t k = b.begin;; ++k)
+        {
+            for (; next != inserts.end() && next->b == id && next->before == k; ++next)
+                instrs.push_back(next->i);
+            if (k == b.end)
+                break;
+            if (!edits.erased(k))
+                instrs.push_back(func.instrs[k]);
+        }
+        b = {begin, (uint32_t)instrs.size()};
     }
+    func.instrs = std::move(instrs);
+}
 
-    for (size_t i = 0; i < basic_blocks.size(); ++i)
+cfg_info build_cfg(const bril_function &func, const std::vector<block> &basic_blocks)
+{
+    cfg_info cfg;
+    const size_t n = basic_blocks.size();
+
+    // Name every block once and index them by label
+    cfg.labels.reserve(n);
+    std::unordered_map<sym, block_id> index;
+    index.reserve(n);
+    for (size_t i = 0; i < n; ++i)
     {
-        const auto &basic_block = basic_blocks[i];
-        std::string label = get_label(basic_blocks, func_name, i);
+        sym label = get_label(func, basic_blocks, i);
+        cfg.labels.push_back(label);
+        index.emplace(label, (block_id)i);
+    }
 
-        std::vector<std::string> next;
+    // successors, in CSR form
+    cfg.succ_off.reserve(n + 1);
+    cfg.succ_off.push_back(0);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const block &basic_block = basic_blocks[i];
+        const instr *last = basic_block.empty() ? nullptr : &func.instrs[basic_block.end - 1];
 
-        if (basic_block.empty() || !basic_block.back().contains("op"))
+        if (!last || last->is_label())
         {
             // successors are just the next block if it exists
-            if (i + 1 < basic_blocks.size())
+            if (i + 1 < n)
             {
-                next.push_back(get_label(basic_blocks, func_name, i + 1));
+                cfg.succ.push_back((block_id)(i + 1));
             }
         }
         else
         {
-            std::string op = basic_block.back().at("op").get<std::string>();
+            opcode op = last->op;
 
-            if (op == "br" || op == "jmp")
-            { // branch or jump
-                if (basic_block.back().contains("labels") && basic_block.back()["labels"].is_array())
+            if (op == opcode::br || op == opcode::jmp)
+            { // branch or jump; targets that name no block are dropped
+                for (sym target_label : func.labels_of(*last))
                 {
-                    for (const auto &target_label : basic_block.back()["labels"])
-                    {
-                        next.push_back(target_label.get<std::string>());
-                    }
+                    auto it = index.find(target_label);
+                    if (it != index.end())
+                        cfg.succ.push_back(it->second);
                 }
             }
-            else if (op == "ret")
+            else if (op == opcode::ret)
             { // next should stay empty for return instructions
             }
-            else if (i + 1 < basic_blocks.size())
+            else if (i + 1 < n)
             { // just go to the next block
-                next.push_back(get_label(basic_blocks, func_name, i + 1));
+                cfg.succ.push_back((block_id)(i + 1));
             }
         }
+        cfg.succ_off.push_back((uint32_t)cfg.succ.size());
+    }
 
-        cfg.successors[label] = next;
+    // predecessors: counting sort of the edges by target, which keeps each
+    // predecessor list in block order
+    cfg.pred_off.assign(n + 1, 0);
+    for (block_id t : cfg.succ)
+        ++cfg.pred_off[t + 1];
+    for (size_t i = 0; i < n; ++i)
+        cfg.pred_off[i + 1] += cfg.pred_off[i];
+    cfg.pred.resize(cfg.succ.size());
+    std::vector<uint32_t> fill(cfg.pred_off.begin(), cfg.pred_off.end() - 1);
+    for (size_t b = 0; b < n; ++b)
+    {
+        for (block_id t : cfg.successors((block_id)b))
+            cfg.pred[fill[t]++] = (block_id)b;
+    }
 
-        // update predecessors of all successors adding this block
-        for (const auto &successor : next)
+    // postorder by iterative DFS from the entry block
+    cfg.rpo_index.assign(n, no_block);
+    if (n > 0)
+    {
+        std::vector<bool> visited(n, false);
+        std::vector<std::pair<block_id, uint32_t>> stack; // (block, next successor slot)
+        stack.push_back({0, cfg.succ_off[0]});
+        visited[0] = true;
+        while (!stack.empty())
         {
-            cfg.predecessors[successor].push_back(label);
+            auto &[b, next] = stack.back();
+            if (next < cfg.succ_off[b + 1])
+            {
+                block_id s = cfg.succ[next++];
+                if (!visited[s])
+                {
+                    visited[s] = true;
+                    stack.push_back({s, cfg.succ_off[s]});
+                }
+            }
+            else
+            {
+                cfg.po.push_back(b);
+                stack.pop_back();
+            }
         }
     }
+    cfg.rpo.assign(cfg.po.rbegin(), cfg.po.rend());
+    for (size_t i = 0; i < cfg.rpo.size(); ++i)
+        cfg.rpo_index[cfg.rpo[i]] = (uint32_t)i;
 
     return cfg;
 }
 
-std::string get_label(const std::vector<std::vector<json>> &basic_blocks, const std::string &func, size_t idx)
+// Tarjan's algorithm with an explicit call stack. Tarjan finishes components
+// sinks first, so the finishing order is flipped at the end.
+scc_info build_sccs(const cfg_info &cfg)
 {
-    const auto &block = basic_blocks.at(idx);
-    if (!block.empty() && block.front().contains("label"))
+    const size_t n = cfg.size();
+    const uint32_t none = UINT32_MAX;
+    std::vector<uint32_t> index(n, none), low(n, 0);
+    std::vector<bool> on_stack(n, false);
+    std::vector<block_id> stack;
+    std::vector<std::pair<block_id, uint32_t>> calls; // (block, next successor slot)
+    std::vector<uint32_t> finished(n); // block -> component in finishing order
+    uint32_t counter = 0, components = 0;
+
+    for (block_id root = 0; root < n; ++root)
     {
-        return block.front().at("label").get<std::string>();
+        if (index[root] != none)
+            continue;
+        index[root] = low[root] = counter++;
+        stack.push_back(root);
+        on_stack[root] = true;
+        calls.push_back({root, cfg.succ_off[root]});
+
+        while (!calls.empty())
+        {
+            auto &[v, next] = calls.back();
+            if (next < cfg.succ_off[v + 1])
+            {
+                block_id w = cfg.succ[next++];
+                if (index[w] == none)
+                {
+                    index[w] = low[w] = counter++;
+                    stack.push_back(w);
+                    on_stack[w] = true;
+                    calls.push_back({w, cfg.succ_off[w]});
+                }
+                else if (on_stack[w])
+                {
+                    low[v] = std::min(low[v], index[w]);
+                }
+                continue;
+            }
+
+            block_id done = v;
+            calls.pop_back();
+            if (low[done] == index[done])
+            {
+                block_id w;
+                do
+                {
+                    w = stack.back();
+                    stack.pop_back();
+                    on_stack[w] = false;
+                    finished[w] = components;
+                } while (w != done);
+                ++components;
+            }
+            if (!calls.empty())
+            {
+                block_id parent = calls.back().first;
+                low[parent] = std::min(low[parent], low[done]);
+            }
+        }
     }
-    return func + "-block" + std::to_string(idx);
+
+    // number components topologically and group their blocks, in block order
+    scc_info scc;
+    scc.comp.resize(n);
+    scc.off.assign(components + 1, 0);
+    for (block_id b = 0; b < n; ++b)
+    {
+        scc.comp[b] = components - 1 - finished[b];
+        ++scc.off[scc.comp[b] + 1];
+    }
+    for (uint32_t c = 0; c < components; ++c)
+        scc.off[c + 1] += scc.off[c];
+    scc.blocks.resize(n);
+    std::vector<uint32_t> fill(scc.off.begin(), scc.off.end() - 1);
+    for (block_id b = 0; b < n; ++b)
+        scc.blocks[fill[scc.comp[b]]++] = b;
+    return scc;
 }
 
-void replace_func_instrs(json &func, const std::vector<std::vector<json>> &blocks)
+sym get_label(const bril_function &func, const std::vector<block> &basic_blocks, size_t idx)
 {
-    func["instrs"] = json::array();
-    for (const auto &b : blocks)
+    const block &b = basic_blocks.at(idx);
+    if (!b.empty() && func.instrs[b.begin].is_label())
     {
-        for (const auto &instr : b)
-            func["instrs"].push_back(instr);
+        return func.instrs[b.begin].label;
     }
+    return func.synthetic_label(idx);
 }
 
-value value::from_json(const json &j)
+value value::from_instr(const bril_function &func, const instr &i)
 {
     value v;
-    if (j.contains("op"))
-        v.op = j.at("op").get<std::string>();
-    if (j.contains("args"))
+    v.op = i.op;
+    if (i.present & instr::HAS_ARGS)
     {
-        for (const auto &arg : j.at("args"))
-            v.vals.push_back(arg.get<std::string>());
+        auto args = func.args_of(i);
+        v.vals.assign(args.begin(), args.end());
     }
-    else if (j.contains("value"))
+    else if (i.value.kind != literal::none)
     {
-        // Treat constants as (op="const", vals=[literal])
-        v.op = "const";
-        if (j["value"].is_number_integer())
-        {
-            v.vals.push_back(std::to_string(j.at("value").get<int>()));
-        }
-        else if (j["value"].is_number_float())
-        {
-            v.vals.push_back(std::to_string(j.at("value").get<double>()));
-        }
-        else if (j["value"].is_boolean())
-        {
-            v.vals.push_back(j.at("value").get<bool>() ? "true" : "false");
-        }
-        else
-        {
-            v.vals.push_back(j.at("value").dump());
-        }
+        // Treat constants as (op=const, lit=literal)
+        v.op = opcode::const_;
+        v.lit = i.value;
     }
     return v;
 }
 
+size_t value_hash::operator()(const value &v) const
+{
+    uint64_t h = (uint64_t)v.op * 0x9e3779b97f4a7c15ull;
+    auto mix = [&](uint64_t x)
+    { h = (h ^ x) * 0x100000001b3ull + (h >> 29); };
+    for (sym s : v.vals)
+        mix(s);
+    mix(v.lit.kind);
+    switch (v.lit.kind)
+    {
+    case literal::int_:
+    case literal::uint_:
+        mix(v.lit.u);
+        break;
+    case literal::float_:
+        mix(v.lit.f == 0.0 ? 0 : v.lit.u);
+        break;
+    case literal::bool_:
+        mix(v.lit.b);
+        break;
+    case literal::char_:
+        mix(v.lit.c);
+        break;
+    default:
+        break;
+    }
+    return h;
+}
+
 using namespace std;
-vector<vector<json>> add_entry(vector<vector<json>> blocks, string func_name)
+bool add_entry(bril_function &func, const vector<block> &blocks)
 {
-    string first_label = get_label(blocks, func_name, 0);
+    if (blocks.empty())
+        return false;
+    sym first = get_label(func, blocks, 0);
 
     // check if any blocks jump here
     bool hasPredecessor = false;
-    for (auto block : blocks)
+    for (const auto &block : blocks)
     {
-        for (auto instr : block)
+        for (const auto &instr : func.instrs_of(block))
         {
-            if (instr.contains("labels"))
+            for (sym lbl : func.labels_of(instr))
             {
-                for (const auto &lbl : instr["labels"])
+                if (lbl == first)
                 {
-                    if (lbl == first_label)
-                    {
-                        hasPredecessor = true;
-                        break;
-                    }
+                    hasPredecessor = true;
+                    break;
                 }
             }
         }
@@ -203,28 +1031,30 @@ vector<vector<json>> add_entry(vector<vector<json>> blocks, string func_name)
 
     if (hasPredecessor)
     {
-        json instr;
-        instr["label"] = "entry";
-        vector<json> entry = {instr};
-        blocks.insert(blocks.begin(), entry);
+        instr entry_label;
+        entry_label.op = opcode::label;
+        entry_label.label = intern("entry");
+        func.instrs.insert(func.instrs.begin(), entry_label);
     }
 
-    return blocks;
+    return hasPredecessor;
 }
 
 // Helper: Get a map from variable names to defining blocks
-unordered_map<string, unordered_set<string>> def_blocks(const map<string, vector<json>> &blocks)
+unordered_map<sym, vector<block_id>> def_blocks(const bril_function &func, const vector<block> &blocks)
 {
-    unordered_map<string, unordered_set<string>> out;
-    for (const auto &[name, block] : blocks)
+    unordered_map<sym, vector<block_id>> out;
+    for (block_id b = 0; b < blocks.size(); ++b)
     {
-        for (const auto &instr : block)
+        for (const auto &instr : func.instrs_of(blocks[b]))
         {
-            if (instr.contains("dest"))
+            if (instr.has_dest())
             {
-                out[instr["dest"].get<string>()].insert(name);
+                auto &sites = out[instr.dest];
+                if (sites.empty() || sites.back() != b)
+                    sites.push_back(b);
             }
         }
     }
     return out;
-}
\ No newline at end of file
+}
@@ -1,5 +1,16 @@
 #pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <iosfwd>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
@@ -8,37 +19,582 @@
 
 using json = nlohmann::json;
 
-bool has_dest(const json& instr);
-std::vector<std::string> get_args(const json& instr);
+// ---------------------------------------------------------------------------
+// Symbols: every variable name, label, function name and type is interned to
+// a dense 32-bit id when the program is loaded.
+// ---------------------------------------------------------------------------
 
-std::vector<std::vector<json>> gen_basic_blocks(const json& function);
-std::string get_label(const std::vector<std::vector<json>>& basic_blocks, const std::string& func, size_t idx);
+using sym = uint32_t;
+constexpr sym no_sym = UINT32_MAX;
 
-void replace_func_instrs(json& func, const std::vector<std::vector<json>>& blocks);
+// Safe to use from several threads: intern() takes a lock (shared for the
+// common case of a name that already exists), and str() takes none. Names
+// live in chunks that never move (chunk k holds first_chunk << k names), and
+// a chunk is in place before any id in it is handed out.
+class symbol_table {
+public:
+    sym intern(std::string_view s);
+    const std::string& str(sym id) const {
+        uint64_t v = (uint64_t)id + first_chunk;
+        int k = 63 - __builtin_clzll(v) - first_chunk_bits;
+        return chunks_[k][v - (first_chunk << k)];
+    }
+    size_t size() const { return size_.load(std::memory_order_acquire); }
+
+    // forgets every symbol, so ids start over from 0; only safe while no
+    // thread holds a sym or a reference into the table
+    void clear();
+
+private:
+    static constexpr int first_chunk_bits = 10;
+    static constexpr uint64_t first_chunk = uint64_t(1) << first_chunk_bits;
+    static constexpr int max_chunks = 33 - first_chunk_bits; // enough for every 32-bit id
+
+    std::unordered_map<std::string_view, sym> ids_; // keys view into the chunks
+    std::unique_ptr<std::string[]> chunks_[max_chunks];
+    std::atomic<size_t> size_{0};
+    mutable std::shared_mutex lock_;
+};
+
+// One table shared by every function and every pass, so ids can be compared
+// and hashed as plain integers anywhere.
+symbol_table& symbols();
+inline sym intern(std::string_view s) { return symbols().intern(s); }
+inline const std::string& sym_name(sym s) { return symbols().str(s); }
+
+// Orders symbols by their text; used where output order must not depend on
+// interning order.
+inline bool name_less(sym a, sym b) { return sym_name(a) < sym_name(b); }
+
+// ---------------------------------------------------------------------------
+// Per-function arenas: the scratch data of the passes (value tables, rename
+// stacks, json built for output) comes from an arena that is released in one
+// go when the function is done, rather than node by node through malloc.
+// ---------------------------------------------------------------------------
+
+// Where an arena's bump allocator gets the blocks past its inline 16 KB.
+// Blocks given back when the arena is rewound are kept, up to keep_limit
+// bytes in all, and handed out again for the same sizes; the bump allocator
+// asks for the same sequence of sizes every time it starts over.
+class arena_blocks : public std::pmr::memory_resource {
+public:
+    arena_blocks() = default;
+    arena_blocks(const arena_blocks&) = delete;
+    arena_blocks& operator=(const arena_blocks&) = delete;
+    ~arena_blocks() override;
+
+    static constexpr size_t keep_limit = 8 << 20;
+
+private:
+    void* do_allocate(size_t bytes, size_t align) override;
+    void do_deallocate(void* p, size_t bytes, size_t align) override;
+    bool do_is_equal(const std::pmr::memory_resource& o) const noexcept override { return this == &o; }
+
+    struct kept {
+        void* p;
+        size_t bytes;
+        size_t align;
+    };
+    std::vector<kept> kept_;
+    size_t kept_bytes_ = 0;
+};
+
+// A bump allocator with free lists: a freed block of up to 1 KB is reused by
+// the next request of its size class, larger ones only come back when the
+// arena dies or is reset. The first 16 KB live in the arena itself, so small
+// functions never touch the heap for their scratch data.
+class function_arena {
+public:
+    function_arena() : bump_(initial_, sizeof initial_, &blocks_) {}
+    function_arena(const function_arena&) = delete;
+    function_arena& operator=(const function_arena&) = delete;
+
+    // `bytes` rounded up to a multiple of 16; the blocks are 16-byte aligned
+    void* allocate(size_t bytes) {
+        ++allocations_;
+        bytes_ += bytes;
+        size_t c = bytes / granule;
+        if (c < size_classes && free_[c]) {
+            void* p = free_[c];
+            free_[c] = *static_cast<void**>(p);
+            return p;
+        }
+        return bump_.allocate(bytes, granule);
+    }
+    void deallocate(void* p, size_t bytes) {
+        size_t c = bytes / granule;
+        if (c < size_classes) {
+            *static_cast<void**>(p) = free_[c];
+            free_[c] = p;
+        }
+    }
+
+    // frees everything at once, keeping the blocks for what comes next;
+    // nothing from the arena may be in use
+    void reset();
+
+    size_t allocations() const { return allocations_; }
+    size_t bytes() const { return bytes_; }
+
+    static constexpr size_t granule = 16;
+
+private:
+    static constexpr size_t size_classes = 1024 / granule + 1;
+
+    alignas(granule) char initial_[16 << 10];
+    arena_blocks blocks_;
+    std::pmr::monotonic_buffer_resource bump_;
+    void* free_[size_classes] = {};
+    size_t allocations_ = 0;
+    size_t bytes_ = 0;
+};
+
+// Makes `arena` the current thread's arena until the scope ends; scopes
+// nest. With arenas switched off, installs none instead.
+class arena_scope {
+public:
+    explicit arena_scope(function_arena& arena);
+    ~arena_scope();
+    arena_scope(const arena_scope&) = delete;
+    arena_scope& operator=(const arena_scope&) = delete;
+
+private:
+    function_arena* saved_;
+};
+
+// The calling thread's own arena, reset and made current for one function.
+// The thread keeps it between functions, so a long-running thread (a -j
+// worker, opt --serve) reuses the blocks it grew into instead of going back
+// to the heap. A scope opened inside another gets a new arena.
+class thread_arena_scope {
+public:
+    thread_arena_scope();
+    ~thread_arena_scope();
+    thread_arena_scope(const thread_arena_scope&) = delete;
+    thread_arena_scope& operator=(const thread_arena_scope&) = delete;
+
+    function_arena& arena() { return *arena_; }
+
+private:
+    std::unique_ptr<function_arena> nested_;
+    function_arena* arena_;
+    std::optional<arena_scope> scope_;
+};
+
+// on by default; off makes every arena_scope a no-op (for measuring)
+void set_arenas_enabled(bool on);
+bool arenas_enabled();
+
+// From the current thread's arena, or the heap outside any arena_scope. Each
+// block records where it came from, so it can be freed from anywhere; it
+// must not outlive its arena.
+void* arena_allocate(size_t bytes);
+void arena_deallocate(void* p, size_t bytes);
+
+// Stateless, so it also fits containers (like nlohmann's) that construct
+// their allocators on the spot.
+template <typename T>
+struct arena_allocator {
+    using value_type = T;
+
+    arena_allocator() = default;
+    template <typename U>
+    arena_allocator(const arena_allocator<U>&) {}
+
+    T* allocate(size_t n) {
+        static_assert(alignof(T) <= function_arena::granule, "over-aligned types need their own allocator");
+        return static_cast<T*>(arena_allocate(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n) { arena_deallocate(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const arena_allocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const arena_allocator<U>&) const { return false; }
+};
+
+template <typename T>
+using arena_vector = std::vector<T, arena_allocator<T>>;
+template <typename K, typename V, typename Less = std::less<K>>
+using arena_map = std::map<K, V, Less, arena_allocator<std::pair<const K, V>>>;
+template <typename K, typename V, typename Hash = std::hash<K>>
+using arena_unordered_map = std::unordered_map<K, V, Hash, std::equal_to<K>, arena_allocator<std::pair<const K, V>>>;
+template <typename K>
+using arena_unordered_set = std::unordered_set<K, std::hash<K>, std::equal_to<K>, arena_allocator<K>>;
+
+// json whose arrays and objects live in the arena; dumps the same as json.
+using arena_json = nlohmann::basic_json<std::map, std::vector, std::string, bool, std::int64_t, std::uint64_t, double,
+                                        arena_allocator>;
+
+// ---------------------------------------------------------------------------
+// Pass IR
+// ---------------------------------------------------------------------------
+
+// Every opcode and what passes may assume about it, in one table:
+//   X(enumerator, name, code, extension, arity, flags)
+// code is the opcode's number in the binary IR (bril_binary.hpp). Rows may be
+// reordered or inserted freely, but a code is never changed or reused: a new
+// opcode takes the next unused one.
+// arity is the number of args, or -1 where it varies. PURE ops compute their
+// result from their args alone, so equal ones can be merged and unused ones
+// dropped; SIDE_EFFECTS ops must stay where they are even if unused.
+#define BRIL_OPCODES(X)                                                           \
+    X(label, "label", 0, core, 0, 0) /* pseudo-op for `{"label": ...}` entries */ \
+    X(const_, "const", 1, core, 0, OP_PURE)                                       \
+    X(id, "id", 2, core, 1, OP_PURE)                                              \
+    X(add, "add", 3, core, 2, OP_PURE | OP_COMMUTATIVE)                           \
+    X(mul, "mul", 4, core, 2, OP_PURE | OP_COMMUTATIVE)                           \
+    X(sub, "sub", 5, core, 2, OP_PURE)                                            \
+    X(div, "div", 6, core, 2, OP_PURE)                                            \
+    X(eq, "eq", 7, core, 2, OP_PURE | OP_COMMUTATIVE)                             \
+    X(lt, "lt", 8, core, 2, OP_PURE)                                              \
+    X(gt, "gt", 9, core, 2, OP_PURE)                                              \
+    X(le, "le", 10, core, 2, OP_PURE)                                             \
+    X(ge, "ge", 11, core, 2, OP_PURE)                                             \
+    X(not_, "not", 12, core, 1, OP_PURE)                                          \
+    X(and_, "and", 13, core, 2, OP_PURE | OP_COMMUTATIVE)                         \
+    X(or_, "or", 14, core, 2, OP_PURE | OP_COMMUTATIVE)                           \
+    X(jmp, "jmp", 15, core, 0, OP_TERMINATOR)                                     \
+    X(br, "br", 16, core, 1, OP_TERMINATOR)                                       \
+    X(call, "call", 17, core, -1, OP_SIDE_EFFECTS)                                \
+    X(ret, "ret", 18, core, -1, OP_TERMINATOR)                                    \
+    X(print, "print", 19, core, -1, OP_SIDE_EFFECTS)                              \
+    X(nop, "nop", 20, core, 0, 0)                                                 \
+    X(get, "get", 21, ssa, 0, 0)                                                  \
+    X(set, "set", 22, ssa, 2, OP_SIDE_EFFECTS)                                    \
+    X(undef, "undef", 23, ssa, 0, 0)                                              \
+    X(phi, "phi", 24, phi, -1, 0)                                                 \
+    X(alloc, "alloc", 25, memory, 1, OP_SIDE_EFFECTS)                             \
+    X(free, "free", 26, memory, 1, OP_SIDE_EFFECTS)                               \
+    X(store, "store", 27, memory, 2, OP_SIDE_EFFECTS)                             \
+    X(load, "load", 28, memory, 1, 0)                                             \
+    X(ptradd, "ptradd", 29, memory, 2, OP_PURE)                                   \
+    X(fadd, "fadd", 30, float_, 2, OP_PURE | OP_COMMUTATIVE)                      \
+    X(fmul, "fmul", 31, float_, 2, OP_PURE | OP_COMMUTATIVE)                      \
+    X(fsub, "fsub", 32, float_, 2, OP_PURE)                                       \
+    X(fdiv, "fdiv", 33, float_, 2, OP_PURE)                                       \
+    X(feq, "feq", 34, float_, 2, OP_PURE | OP_COMMUTATIVE)                        \
+    X(flt, "flt", 35, float_, 2, OP_PURE)                                         \
+    X(fle, "fle", 36, float_, 2, OP_PURE)                                         \
+    X(fgt, "fgt", 37, float_, 2, OP_PURE)                                         \
+    X(fge, "fge", 38, float_, 2, OP_PURE)                                         \
+    X(ceq, "ceq", 39, char_, 2, OP_PURE | OP_COMMUTATIVE)                         \
+    X(clt, "clt", 40, char_, 2, OP_PURE)                                          \
+    X(cle, "cle", 41, char_, 2, OP_PURE)                                          \
+    X(cgt, "cgt", 42, char_, 2, OP_PURE)                                          \
+    X(cge, "cge", 43, char_, 2, OP_PURE)                                          \
+    X(char2int, "char2int", 44, char_, 1, OP_PURE)                                \
+    X(int2char, "int2char", 45, char_, 1, OP_PURE)                                \
+    X(speculate, "speculate", 46, speculation, 0, OP_SIDE_EFFECTS)                \
+    X(commit, "commit", 47, speculation, 0, OP_SIDE_EFFECTS)                      \
+    X(guard, "guard", 48, speculation, 1, OP_SIDE_EFFECTS)                        \
+    X(unknown, "unknown", 49, core, -1, OP_SIDE_EFFECTS) /* op name kept in the instruction's extra fields */
+
+enum class opcode : uint8_t {
+#define BRIL_OPCODE_ENUM(op, name, code, ext, arity, flags) op,
+    BRIL_OPCODES(BRIL_OPCODE_ENUM)
+#undef BRIL_OPCODE_ENUM
+};
+
+// The Bril extension an opcode comes from; phi is the older SSA form, get,
+// set and undef the current one.
+enum class bril_extension : uint8_t { core, ssa, phi, memory, float_, char_, speculation };
+
+enum opcode_flag : uint8_t { OP_TERMINATOR = 1, OP_PURE = 2, OP_COMMUTATIVE = 4, OP_SIDE_EFFECTS = 8 };
+
+struct opcode_info {
+    const char* name;
+    uint8_t code;
+    bril_extension extension;
+    int8_t arity;
+    uint8_t flags;
+};
+
+inline constexpr opcode_info opcode_table[] = {
+#define BRIL_OPCODE_INFO(op, name, code, ext, arity, flags) {name, code, bril_extension::ext, arity, flags},
+    BRIL_OPCODES(BRIL_OPCODE_INFO)
+#undef BRIL_OPCODE_INFO
+};
+static_assert(sizeof opcode_table / sizeof opcode_table[0] == (size_t)opcode::unknown + 1, "one row per opcode");
+
+constexpr const opcode_info& op_info(opcode op) { return opcode_table[(size_t)op]; }
+constexpr const char* opcode_name(opcode op) { return op_info(op).name; }
+constexpr uint8_t opcode_code(opcode op) { return op_info(op).code; }
+constexpr bril_extension opcode_extension(opcode op) { return op_info(op).extension; }
+constexpr int opcode_arity(opcode op) { return op_info(op).arity; }
+constexpr bool is_terminator(opcode op) { return op_info(op).flags & OP_TERMINATOR; }
+constexpr bool is_pure(opcode op) { return op_info(op).flags & OP_PURE; }
+constexpr bool is_commutative(opcode op) { return op_info(op).flags & OP_COMMUTATIVE; }
+constexpr bool has_side_effects(opcode op) { return op_info(op).flags & OP_SIDE_EFFECTS; }
+
+opcode opcode_from_name(const std::string& name);
 
+// Typed literal for `const` instructions.
+struct literal {
+    enum kind_t : uint8_t { none, int_, uint_, float_, bool_, char_ } kind = none;
+    union {
+        int64_t i;
+        uint64_t u;
+        double f;
+        bool b;
+        sym c;
+    };
+
+    literal() : i(0) {}
+
+    bool operator==(const literal& other) const;
+    bool operator!=(const literal& other) const { return !(*this == other); }
+    bool operator<(const literal& other) const;
+};
+
+// Range of symbols stored in the owning function's operand pool.
+struct operand_list {
+    uint32_t off = 0;
+    uint32_t len = 0;
+};
+
+// A basic block: the run of instructions func.instrs[begin, end), as
+// operand_list is a run of func.operands. See gen_basic_blocks.
+struct block {
+    uint32_t begin = 0;
+    uint32_t end = 0;
+
+    size_t size() const { return end - begin; }
+    bool empty() const { return begin == end; }
+};
+
+// Non-owning view of a run of ids (operands, CSR edge lists, instructions).
+template <typename T>
+struct id_span {
+    T* first;
+    T* last;
+    T* begin() const { return first; }
+    T* end() const { return last; }
+    size_t size() const { return last - first; }
+    bool empty() const { return first == last; }
+    T& operator[](size_t i) const { return first[i]; }
+};
+
+struct instr {
+    // presence flags so that `"args": []` and a missing "args" round-trip
+    enum : uint8_t { HAS_ARGS = 1, HAS_FUNCS = 2, HAS_LABELS = 4 };
+
+    opcode op = opcode::nop;
+    uint8_t present = 0;
+    sym dest = no_sym;
+    sym type = no_sym;  // interned type; parameterized types are stored as compact json
+    sym label = no_sym; // only for opcode::label
+    operand_list args;
+    operand_list funcs;
+    operand_list labels;
+    literal value;
+    int32_t extra = -1; // index into function::extras for fields we don't model
+
+    bool is_label() const { return op == opcode::label; }
+    bool has_dest() const { return dest != no_sym; }
+};
+
+struct func_arg {
+    sym name;
+    sym type;
+};
+
+struct bril_function {
+    sym name = no_sym;
+    sym type = no_sym;
+    bool has_args = false;
+    std::vector<func_arg> args;
+    std::vector<instr> instrs;
+    std::vector<sym> operands;  // args/funcs/labels of every instruction, back to back
+    std::vector<json> extras;   // unmodelled instruction fields (e.g. "pos")
+    json extra = json::object(); // unmodelled function fields
+
+    id_span<const sym> args_of(const instr& i) const { return span(i.args); }
+    id_span<const sym> funcs_of(const instr& i) const { return span(i.funcs); }
+    id_span<const sym> labels_of(const instr& i) const { return span(i.labels); }
+    id_span<sym> args_of(instr& i) { return span(i.args); }
+    id_span<const instr> instrs_of(const block& b) const { return {instrs.data() + b.begin, instrs.data() + b.end}; }
+    id_span<instr> instrs_of(const block& b) { return {instrs.data() + b.begin, instrs.data() + b.end}; }
+
+    operand_list add_operands(const sym* first, size_t n);
+    operand_list add_operands(const std::vector<sym>& v) { return add_operands(v.data(), v.size()); }
+    operand_list add_operands(std::initializer_list<sym> v) { return add_operands(v.begin(), v.size()); }
+
+    // "<name>-block<idx>", the label of unlabelled block idx (see get_label);
+    // made once per index and kept, as the CFG is rebuilt after most passes
+    sym synthetic_label(size_t idx) const;
+
+private:
+    id_span<const sym> span(operand_list l) const { return {operands.data() + l.off, operands.data() + l.off + l.len}; }
+    id_span<sym> span(operand_list l) { return {operands.data() + l.off, operands.data() + l.off + l.len}; }
+
+    mutable std::vector<sym> synthetic_labels_; // no_sym where not made yet
+};
+
+struct program {
+    std::vector<bril_function> functions;
+    json extra = json::object(); // top-level fields other than "functions"
+};
+
+// json import/export at the edges of every tool
+program program_from_json(const json& j);
+json program_to_json(const program& prog);
+bril_function function_from_json(const json& j);
+// J is json or arena_json
+template <typename J = json>
+J function_to_json(const bril_function& func);
+template <typename J = json>
+J instr_to_json(const bril_function& func, const instr& i);
+
+// With BRIL_SIMD_JSON (make JSON=simd) these use the fast front end in
+// fast_json.cpp; the output is the same either way.
+program read_program(std::istream& in);
+void write_program(std::ostream& out, const program& prog, int indent = -1);
+
+// program_from_json(json::parse(input)) without building a json DOM
+program read_program_simd(std::string_view input);
+// write_program(out, prog) without building a json DOM
+void write_program_compact(std::ostream& out, const program& prog);
+
+// Streaming alternative to read_program: parses the "functions" array one
+// function at a time and hands each to `each` before reading the next, so
+// memory is bounded by the largest function rather than the whole program.
+// Returns the other top-level fields.
+json read_program_streaming(std::istream& in, const std::function<void(bril_function&)>& each);
+
+// Writes a program one function at a time, in write_program's format. The
+// other top-level fields go after "functions" rather than in sorted order,
+// since a stream only knows them at the end.
+class program_writer {
+public:
+    program_writer(std::ostream& out, int indent = -1) : out_(out), indent_(indent) {}
+    void write_function(const bril_function& func);
+    void finish(const json& extra = json::object());
+
+private:
+    void newline(int level);
+    void write_key(const std::string& key);
+    template <typename J>
+    void write_value(const J& v, int level);
+
+    std::ostream& out_;
+    int indent_;
+    size_t written_ = 0;
+};
+
+std::vector<sym> func_arg_names(const bril_function& func);
+
+// ---------------------------------------------------------------------------
+// Basic blocks and CFG
+// ---------------------------------------------------------------------------
+
+bool has_dest(const instr& i);
+std::vector<sym> get_args(const bril_function& func, const instr& i);
+
+// Splits the function into blocks without copying any instructions; the
+// result is only the table of ranges. Instructions after a terminator and
+// before the next label are unreachable and belong to no block. Passes edit
+// instructions in place through func.instrs_of(b); anything that changes
+// the length of a block goes through a block_rewrite and rebuild_blocks.
+std::vector<block> gen_basic_blocks(const bril_function& func);
+sym get_label(const bril_function& func, const std::vector<block>& basic_blocks, size_t idx);
+
+// Index of a basic block in the vector returned by gen_basic_blocks.
+using block_id = uint32_t;
+constexpr block_id no_block = UINT32_MAX;
+
+// Instructions to insert into blocks and to drop from them, applied in one
+// go by rebuild_blocks.
+class block_rewrite {
+public:
+    // `i` goes in front of func.instrs[before], which is in block b or is
+    // its end. Insertions at the same place keep the order they were made in.
+    void insert(block_id b, uint32_t before, const instr& i) { inserts_.push_back({b, before, i}); }
+    // drops func.instrs[at]
+    void erase(uint32_t at);
+    bool erased(uint32_t at) const { return at < erased_.size() && erased_[at]; }
+    bool empty() const { return inserts_.empty() && !any_erased_; }
+
+private:
+    friend void rebuild_blocks(bril_function&, std::vector<block>&, block_rewrite);
+
+    struct insertion {
+        block_id b;
+        uint32_t before;
+        instr i;
+    };
+    std::vector<insertion> inserts_;
+    std::vector<bool> erased_;
+    bool any_erased_ = false;
+};
+
+// Makes func.instrs the blocks in order with the edits applied, and moves
+// the blocks to their new ranges. Instructions in no block are dropped.
+// Without insertions this compacts func.instrs in place.
+void rebuild_blocks(bril_function& func, std::vector<block>& blocks, block_rewrite edits = {});
+
+// CFG over dense block ids. Edges are stored in compressed sparse row form:
+// the successors of b are succ[succ_off[b] .. succ_off[b + 1]), likewise for
+// predecessors. Block 0 is the entry.
 struct cfg_info {
-    std::map<std::string, std::vector<std::string>> successors;
-    std::map<std::string, std::vector<std::string>> predecessors;
+    std::vector<sym> labels; // block id -> label
+    std::vector<uint32_t> succ_off;
+    std::vector<block_id> succ;
+    std::vector<uint32_t> pred_off;
+    std::vector<block_id> pred;
+    std::vector<block_id> rpo;       // blocks reachable from entry, reverse postorder
+    std::vector<block_id> po;        // same blocks, postorder
+    std::vector<uint32_t> rpo_index; // block id -> position in rpo, or no_block if unreachable
+
+    size_t size() const { return labels.size(); }
+    id_span<const block_id> successors(block_id b) const { return {succ.data() + succ_off[b], succ.data() + succ_off[b + 1]}; }
+    id_span<const block_id> predecessors(block_id b) const { return {pred.data() + pred_off[b], pred.data() + pred_off[b + 1]}; }
+    bool reachable(block_id b) const { return rpo_index[b] != no_block; }
 };
 
-cfg_info build_cfg(const std::string& func_name, const std::vector<std::vector<json>>& basic_blocks);
+cfg_info build_cfg(const bril_function& func, const std::vector<block>& basic_blocks);
 
-// Value struct for LVN
+// Strongly connected components of the CFG, over every block (reachable or
+// not). Components are numbered in topological order, so an edge never leads
+// from a component to an earlier one. The members of component c are
+// blocks[off[c] .. off[c + 1]), in block order.
+struct scc_info {
+    std::vector<uint32_t> comp; // block id -> component
+    std::vector<uint32_t> off;
+    std::vector<block_id> blocks;
+
+    size_t size() const { return off.size() - 1; }
+    id_span<const block_id> members(uint32_t c) const { return {blocks.data() + off[c], blocks.data() + off[c + 1]}; }
+};
+
+scc_info build_sccs(const cfg_info& cfg);
+
+// Value struct for LVN; scratch data, so its operands are in the arena
 struct value {
-    std::string op;
-    std::vector<std::string> vals;
+    opcode op;
+    arena_vector<sym> vals;
+    literal lit;
 
     bool operator==(const value& other) const {
-        return op == other.op && vals == other.vals;
+        return op == other.op && vals == other.vals && lit == other.lit;
     }
     bool operator<(const value& other) const {
         if (op != other.op) return op < other.op;
-        return vals < other.vals;
+        if (vals != other.vals) return vals < other.vals;
+        return lit < other.lit;
     }
 
-    static value from_json(const json& j);
+    static value from_instr(const bril_function& func, const instr& i);
+};
+
+// Agrees with value::operator==, so 0.0 and -0.0 hash alike.
+struct value_hash {
+    size_t operator()(const value& v) const;
 };
 
 
-std::vector<std::vector<json>> add_entry(std::vector<std::vector<json>> blocks, std::string func_name);
-std::unordered_map<std::string, std::unordered_set<std::string>> def_blocks(const std::map<std::string, std::vector<json>> &blocks);
\ No newline at end of file
+// If some block jumps to the first one, puts an "entry" label in front of
+// func.instrs so the entry block has no predecessors. true if it did, which
+// leaves `blocks` stale.
+bool add_entry(bril_function& func, const std::vector<block>& blocks);
+std::unordered_map<sym, std::vector<block_id>> def_blocks(const bril_function& func, const std::vector<block> &blocks);
@@ -0,0 +1,143 @@
+#include "dataflow.hpp"
+
+using namespace std;
+
+template <typename Solver>
+static void collect(const Solver& solver, size_t blocks, dataflow_result& r) {
+    r.in.reserve(blocks);
+    r.out.reserve(blocks);
+    for (block_id b = 0; b < blocks; ++b) {
+        r.in.push_back(solver.in(b));
+        r.out.push_back(solver.out(b));
+    }
+    r.visits = solver.visits();
+}
+
+// Definitions are identified by their instruction json, so two identical
+// instructions count as one definition.
+reaching_result reaching_definitions(const bril_function& func, const vector<block>& blocks, const cfg_info& cfg, solve_mode mode, unsigned threads) {
+    reaching_result r;
+    unordered_map<string, uint32_t> def_ids;
+    vector<vector<uint32_t>> block_defs(blocks.size()); // def id of each defining instr, in order
+    for (block_id b = 0; b < blocks.size(); ++b) {
+        for (const instr& i : func.instrs_of(blocks[b])) {
+            if (!i.has_dest()) continue;
+            string text = instr_to_json<arena_json>(func, i).dump();
+            auto [it, added] = def_ids.emplace(text, (uint32_t)r.names.size());
+            if (added) {
+                r.names.push_back(move(text));
+                r.vars.push_back(i.dest);
+            }
+            block_defs[b].push_back(it->second);
+        }
+    }
+    const size_t width = r.names.size();
+
+    unordered_map<sym, vector<uint32_t>> defs_of_var;
+    for (uint32_t d = 0; d < width; ++d) defs_of_var[r.vars[d]].push_back(d);
+
+    // kill = every definition of a variable the block assigns
+    // gen = the last definition of each of those variables
+    gen_kill t(blocks.size(), width);
+    for (block_id b = 0; b < blocks.size(); ++b) {
+        unordered_map<sym, uint32_t> last;
+        for (uint32_t d : block_defs[b]) last[r.vars[d]] = d;
+        for (const auto& [var, d] : last) {
+            for (uint32_t k : defs_of_var[var]) t.kill[b].set(k);
+            t.gen[b].set(d);
+        }
+    }
+
+    Dataflow<forward_analysis, may_lattice, gen_kill> solver(cfg, width, move(t));
+    solver.solve(mode, threads);
+    collect(solver, blocks.size(), r);
+    return r;
+}
+
+dataflow_result live_variables(const bril_function& func, const vector<block>& blocks, const cfg_info& cfg, solve_mode mode, unsigned threads) {
+    dataflow_result r;
+    unordered_map<sym, uint32_t> var_ids;
+    auto id_of = [&](sym v) {
+        auto [it, added] = var_ids.emplace(v, (uint32_t)r.names.size());
+        if (added) r.names.push_back(sym_name(v));
+        return it->second;
+    };
+    for (const block& b : blocks) {
+        for (const instr& i : func.instrs_of(b)) {
+            for (sym a : func.args_of(i)) id_of(a);
+            if (i.has_dest()) id_of(i.dest);
+        }
+    }
+    const size_t width = r.names.size();
+
+    // gen = used before any assignment in the block, kill = assigned
+    gen_kill t(blocks.size(), width);
+    for (block_id b = 0; b < blocks.size(); ++b) {
+        for (const instr& i : func.instrs_of(blocks[b])) {
+            for (sym a : func.args_of(i)) {
+                uint32_t v = var_ids[a];
+                if (!t.kill[b].test(v)) t.gen[b].set(v);
+            }
+            if (i.has_dest()) t.kill[b].set(var_ids[i.dest]);
+        }
+    }
+
+    Dataflow<backward_analysis, may_lattice, gen_kill> solver(cfg, width, move(t));
+    solver.solve(mode, threads);
+    collect(solver, blocks.size(), r);
+    return r;
+}
+
+// value ops with no side effects whose result only depends on their args;
+// copies and constants are not worth tracking
+static bool is_expression(opcode op) {
+    return is_pure(op) && opcode_arity(op) > 0 && op != opcode::id;
+}
+
+dataflow_result available_expressions(const bril_function& func, const vector<block>& blocks, const cfg_info& cfg, solve_mode mode, unsigned threads) {
+    dataflow_result r;
+    map<value, uint32_t> expr_ids;
+    unordered_map<sym, vector<uint32_t>> uses; // var -> expressions reading it
+    vector<vector<pair<uint32_t, sym>>> block_exprs(blocks.size()); // (expr or -1, assigned var)
+    for (block_id b = 0; b < blocks.size(); ++b) {
+        for (const instr& i : func.instrs_of(blocks[b])) {
+            if (!i.has_dest()) continue;
+            uint32_t e = UINT32_MAX;
+            if (is_expression(i.op)) {
+                value v = value::from_instr(func, i);
+                auto [it, added] = expr_ids.emplace(v, (uint32_t)r.names.size());
+                if (added) {
+                    string text = opcode_name(i.op);
+                    for (sym a : v.vals) {
+                        text += " " + sym_name(a);
+                        uses[a].push_back(it->second);
+                    }
+                    r.names.push_back(move(text));
+                }
+                e = it->second;
+            }
+            block_exprs[b].push_back({e, i.dest});
+        }
+    }
+    const size_t width = r.names.size();
+
+    // walk the block: each computation makes its expression available, each
+    // assignment kills the expressions that read the assigned variable
+    gen_kill t(blocks.size(), width);
+    for (block_id b = 0; b < blocks.size(); ++b) {
+        for (const auto& [e, dest] : block_exprs[b]) {
+            if (e != UINT32_MAX) t.gen[b].set(e);
+            auto it = uses.find(dest);
+            if (it == uses.end()) continue;
+            for (uint32_t k : it->second) {
+                t.gen[b].reset(k);
+                t.kill[b].set(k);
+            }
+        }
+    }
+
+    Dataflow<forward_analysis, must_lattice, gen_kill> solver(cfg, width, move(t));
+    solver.solve(mode, threads);
+    collect(solver, blocks.size(), r);
+    return r;
+}
@@ -0,0 +1,254 @@
+#pragma once
+#include "common.hpp"
+#include "bitvec.hpp"
+#include "work_pool.hpp"
+#include <atomic>
+#include <memory>
+#include <queue>
+#include <string>
+#include <type_traits>
+
+// ---------------------------------------------------------------------------
+// Generic bit-vector dataflow over a cfg_info.
+//
+// Dataflow<Direction, Lattice, Transfer> solves one analysis whose facts are
+// bitvecs of a fixed width (one bit per definition, variable, expression...).
+//   Direction: forward_analysis or backward_analysis
+//   Lattice:   may_lattice (meet = union, top = {}) or
+//              must_lattice (meet = intersection, top = everything)
+//   Transfer:  callable (block_id, const bitvec& x, bitvec& result), applied
+//              in the direction of flow; gen_kill covers the usual case
+// in(b) is always the fact at the top of block b and out(b) the one at the
+// bottom, whichever way the analysis flows.
+// ---------------------------------------------------------------------------
+
+struct forward_analysis {
+    static id_span<const block_id> sources(const cfg_info& cfg, block_id b) { return cfg.predecessors(b); }
+    static id_span<const block_id> sinks(const cfg_info& cfg, block_id b) { return cfg.successors(b); }
+    // blocks that start from the boundary value: the entry and anything else
+    // without predecessors
+    static bool at_boundary(const cfg_info& cfg, block_id b) { return b == 0 || cfg.predecessors(b).empty(); }
+    // reverse postorder, then unreachable blocks in block order
+    static std::vector<block_id> order(const cfg_info& cfg) {
+        std::vector<block_id> o(cfg.rpo.begin(), cfg.rpo.end());
+        for (block_id b = 0; b < cfg.size(); ++b) {
+            if (!cfg.reachable(b)) o.push_back(b);
+        }
+        return o;
+    }
+};
+
+struct backward_analysis {
+    static id_span<const block_id> sources(const cfg_info& cfg, block_id b) { return cfg.successors(b); }
+    static id_span<const block_id> sinks(const cfg_info& cfg, block_id b) { return cfg.predecessors(b); }
+    static bool at_boundary(const cfg_info& cfg, block_id b) { return cfg.successors(b).empty(); }
+    static std::vector<block_id> order(const cfg_info& cfg) {
+        std::vector<block_id> o = forward_analysis::order(cfg);
+        return std::vector<block_id>(o.rbegin(), o.rend());
+    }
+};
+
+struct may_lattice {
+    static bitvec top(size_t width) { return bitvec(width, false); }
+    static void meet(bitvec& into, const bitvec& x) { into |= x; }
+};
+
+struct must_lattice {
+    static bitvec top(size_t width) { return bitvec(width, true); }
+    static void meet(bitvec& into, const bitvec& x) { into &= x; }
+};
+
+// result = gen[b] | (x & ~kill[b])
+struct gen_kill {
+    std::vector<bitvec> gen;
+    std::vector<bitvec> kill;
+
+    gen_kill(size_t blocks, size_t width) : gen(blocks, bitvec(width)), kill(blocks, bitvec(width)) {}
+
+    void operator()(block_id b, const bitvec& x, bitvec& result) const {
+        result.assign_transfer(x, gen[b], kill[b]);
+    }
+};
+
+enum class solve_mode { worklist, scc, parallel };
+
+// "worklist" / "scc" / "parallel"; returns false for an unknown name
+inline bool solve_mode_from_name(const std::string& name, solve_mode& out) {
+    if (name == "worklist") out = solve_mode::worklist;
+    else if (name == "scc") out = solve_mode::scc;
+    else if (name == "parallel") out = solve_mode::parallel;
+    else return false;
+    return true;
+}
+
+template <typename Direction, typename Lattice, typename Transfer>
+class Dataflow {
+public:
+    // boundary: fact flowing into the entry (forward) or out of the exits
+    // (backward); empty if not given
+    Dataflow(const cfg_info& cfg, size_t width, Transfer transfer, bitvec boundary = {})
+        : cfg_(cfg), width_(width), transfer_(std::move(transfer)),
+          boundary_(boundary.size() == width ? std::move(boundary) : bitvec(width)),
+          in_(cfg.size(), Lattice::top(width)), out_(cfg.size(), Lattice::top(width)) {}
+
+    // worklist = all blocks
+    // while worklist is not empty:
+    //     b = earliest block in the worklist (reverse postorder for forward
+    //         problems, postorder for backward ones)
+    //     before[b] = meet(after[s] for every source s of b)
+    //     after[b] = transfer(b, before[b])
+    //     if after[b] changed:
+    //         worklist += sinks of b
+    // A block is queued at most once at a time.
+    //
+    // solve_mode::scc runs the same loop once per strongly connected
+    // component, components in topological order of the flow. Nothing
+    // outside a component can change once it is done, so only its own
+    // blocks are ever re-queued, and acyclic components cost one visit.
+    //
+    // solve_mode::parallel solves the components as tasks on a work_pool
+    // with `threads` workers (0 = one per hardware thread). Each component
+    // keeps an atomic count of the flow edges still to arrive from unfinished
+    // components; whoever finishes the last of them spawns it. A component
+    // only writes its own blocks' facts and only reads finished neighbours',
+    // so every component sees the same inputs as in scc mode and the result
+    // and visit count are identical to it.
+    void solve(solve_mode mode = solve_mode::worklist, unsigned threads = 0) {
+        const size_t n = cfg_.size();
+        std::vector<block_id> order = Direction::order(cfg_);
+        std::vector<uint32_t> priority(n);
+        for (uint32_t i = 0; i < order.size(); ++i) priority[order[i]] = i;
+
+        visits_ = 0;
+        std::vector<char> queued(n, 0);
+        if (mode == solve_mode::worklist) {
+            heap worklist;
+            for (block_id b : order) push(worklist, queued, priority, b);
+            visits_ = drain(worklist, queued, order, priority, nullptr, 0);
+            return;
+        }
+
+        scc_info scc = build_sccs(cfg_);
+        auto solve_component = [&](uint32_t c) {
+            heap worklist;
+            for (block_id b : scc.members(c)) push(worklist, queued, priority, b);
+            return drain(worklist, queued, order, priority, &scc.comp, c);
+        };
+
+        if (mode == solve_mode::scc) {
+            for (uint32_t i = 0; i < scc.size(); ++i) visits_ += solve_component(is_forward() ? i : scc.size() - 1 - i);
+            return;
+        }
+
+        // flow edges into each component from other components
+        std::unique_ptr<std::atomic<uint32_t>[]> waiting(new std::atomic<uint32_t>[scc.size()]);
+        for (uint32_t c = 0; c < scc.size(); ++c) waiting[c].store(0, std::memory_order_relaxed);
+        for (block_id b = 0; b < n; ++b) {
+            for (block_id s : Direction::sinks(cfg_, b)) {
+                if (scc.comp[s] != scc.comp[b]) waiting[scc.comp[s]].fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        work_pool pool(threads);
+        std::atomic<size_t> visits{0};
+        std::function<void(uint32_t)> run_component = [&](uint32_t c) {
+            visits.fetch_add(solve_component(c), std::memory_order_relaxed);
+            for (block_id b : scc.members(c)) {
+                for (block_id s : Direction::sinks(cfg_, b)) {
+                    uint32_t next = scc.comp[s];
+                    if (next != c && waiting[next].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                        pool.spawn([&, next] { run_component(next); });
+                    }
+                }
+            }
+        };
+
+        std::vector<work_pool::task> ready;
+        for (uint32_t c = 0; c < scc.size(); ++c) {
+            if (waiting[c].load(std::memory_order_relaxed) == 0) ready.push_back([&, c] { run_component(c); });
+        }
+        pool.run(std::move(ready));
+        visits_ = visits.load();
+    }
+
+    const bitvec& in(block_id b) const { return in_[b]; }
+    const bitvec& out(block_id b) const { return out_[b]; }
+    size_t width() const { return width_; }
+    size_t visits() const { return visits_; } // blocks processed by the last solve()
+
+private:
+    using heap = std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>>;
+
+    static void push(heap& worklist, std::vector<char>& queued, const std::vector<uint32_t>& priority, block_id b) {
+        if (queued[b]) return;
+        queued[b] = 1;
+        worklist.push(priority[b]);
+    }
+
+    // run the worklist dry and return the number of visits; with comp set,
+    // only blocks of component c are re-queued
+    size_t drain(heap& worklist, std::vector<char>& queued, const std::vector<block_id>& order,
+                 const std::vector<uint32_t>& priority, const std::vector<uint32_t>* comp, uint32_t c) {
+        size_t visits = 0;
+        bitvec fresh(width_);
+        while (!worklist.empty()) {
+            block_id b = order[worklist.top()];
+            worklist.pop();
+            queued[b] = 0;
+            ++visits;
+
+            bitvec& before = is_forward() ? in_[b] : out_[b];
+            bitvec& after = is_forward() ? out_[b] : in_[b];
+
+            before = Direction::at_boundary(cfg_, b) ? boundary_ : Lattice::top(width_);
+            for (block_id s : Direction::sources(cfg_, b)) Lattice::meet(before, is_forward() ? out_[s] : in_[s]);
+
+            transfer_(b, before, fresh);
+            if (fresh != after) {
+                std::swap(after, fresh);
+                for (block_id s : Direction::sinks(cfg_, b)) {
+                    if (!comp || (*comp)[s] == c) push(worklist, queued, priority, s);
+                }
+            }
+        }
+        return visits;
+    }
+
+    static constexpr bool is_forward() { return std::is_same<Direction, forward_analysis>::value; }
+
+    const cfg_info& cfg_;
+    size_t width_;
+    Transfer transfer_;
+    bitvec boundary_;
+    std::vector<bitvec> in_;
+    std::vector<bitvec> out_;
+    size_t visits_ = 0;
+};
+
+// ---------------------------------------------------------------------------
+// Analyses built on Dataflow. Each result names what every bit stands for
+// and keeps the per-block facts.
+// ---------------------------------------------------------------------------
+
+struct dataflow_result {
+    std::vector<std::string> names; // bit -> printable fact
+    std::vector<bitvec> in;
+    std::vector<bitvec> out;
+    size_t visits = 0; // blocks the solver processed
+};
+
+// Forward, may. One bit per distinct defining instruction; vars[bit] is the
+// variable it defines and names[bit] the instruction's json.
+struct reaching_result : dataflow_result {
+    std::vector<sym> vars;
+};
+reaching_result reaching_definitions(const bril_function& func, const std::vector<block>& blocks, const cfg_info& cfg,
+                                     solve_mode mode = solve_mode::worklist, unsigned threads = 0);
+
+// Backward, may. One bit per variable.
+dataflow_result live_variables(const bril_function& func, const std::vector<block>& blocks, const cfg_info& cfg,
+                               solve_mode mode = solve_mode::worklist, unsigned threads = 0);
+
+// Forward, must. One bit per pure expression (op and operands).
+dataflow_result available_expressions(const bril_function& func, const std::vector<block>& blocks, const cfg_info& cfg,
+                                      solve_mode mode = solve_mode::worklist, unsigned threads = 0);
@@ -0,0 +1,124 @@
+#include "common.hpp"
+#include "dataflow.hpp"
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+// Scaling of the parallel dataflow solver on one large generated function.
+// usage: dataflow_bench [chains] [loops_per_chain] [max_threads]
+//
+// The function fans out from the entry into `chains` independent chains of
+// two-block loops that join again at the end, so the SCC condensation has
+// `chains`-wide parallelism. Every block assigns a few of 64 shared
+// variables, which keeps reaching-definitions bitvecs wide and kills busy.
+// Prints reaching-definitions solve times for the scc mode and for the
+// parallel mode at 1, 2, 4, ... max_threads, checking each result against scc.
+
+static int defs_per_block = 4;
+
+static void add_label(bril_function& func, const string& name) {
+    instr i;
+    i.op = opcode::label;
+    i.label = intern(name);
+    func.instrs.push_back(i);
+}
+
+static void add_jump(bril_function& func, sym cond, const string& t, const string& f = "") {
+    instr i;
+    i.present = instr::HAS_LABELS;
+    if (f.empty()) {
+        i.op = opcode::jmp;
+        i.labels = func.add_operands({intern(t)});
+    } else {
+        i.op = opcode::br;
+        i.present |= instr::HAS_ARGS;
+        i.args = func.add_operands({cond});
+        i.labels = func.add_operands({intern(t), intern(f)});
+    }
+    func.instrs.push_back(i);
+}
+
+static void add_defs(bril_function& func, size_t& counter) {
+    for (int k = 0; k < defs_per_block; ++k, ++counter) {
+        instr c;
+        c.op = opcode::const_;
+        c.dest = intern("v" + to_string(counter % 64));
+        c.type = intern("int");
+        c.value.kind = literal::int_;
+        c.value.i = counter; // distinct json, so every def is its own bit
+        func.instrs.push_back(c);
+    }
+}
+
+static bril_function gen_function(size_t chains, size_t loops) {
+    bril_function func;
+    func.name = intern("bench");
+    sym cond = intern("c");
+
+    instr c;
+    c.op = opcode::const_;
+    c.dest = cond;
+    c.type = intern("bool");
+    c.value.kind = literal::bool_;
+    c.value.b = true;
+    func.instrs.push_back(c);
+
+    size_t counter = 0;
+    for (size_t i = 0; i < chains; ++i) {
+        add_label(func, "fan" + to_string(i));
+        add_jump(func, cond, "head" + to_string(i) + "_0", i + 1 < chains ? "fan" + to_string(i + 1) : "join");
+    }
+    for (size_t i = 0; i < chains; ++i) {
+        for (size_t j = 0; j < loops; ++j) {
+            string id = to_string(i) + "_" + to_string(j);
+            string next = j + 1 < loops ? "head" + to_string(i) + "_" + to_string(j + 1) : "join";
+            add_label(func, "head" + id);
+            add_defs(func, counter);
+            add_label(func, "latch" + id);
+            add_defs(func, counter);
+            add_jump(func, cond, "head" + id, next);
+        }
+    }
+    add_label(func, "join");
+    instr r;
+    r.op = opcode::ret;
+    func.instrs.push_back(r);
+    return func;
+}
+
+int main(int argc, char** argv) {
+    size_t chains = argc > 1 ? stoul(argv[1]) : 16;
+    size_t loops = argc > 2 ? stoul(argv[2]) : 100;
+    unsigned max_threads = argc > 3 ? stoul(argv[3]) : max(1u, thread::hardware_concurrency());
+
+    bril_function func = gen_function(chains, loops);
+    auto blocks = gen_basic_blocks(func);
+    cfg_info cfg = build_cfg(func, blocks);
+    cout << cfg.size() << " blocks, " << build_sccs(cfg).size() << " sccs\n";
+
+    auto timed = [&](solve_mode mode, unsigned threads, reaching_result& r) {
+        auto start = chrono::steady_clock::now();
+        r = reaching_definitions(func, blocks, cfg, mode, threads);
+        return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    };
+
+    reaching_result base;
+    double base_ms = timed(solve_mode::scc, 0, base);
+    cout << base.names.size() << " definitions\n";
+    cout << "mode\tthreads\tms\tvisits\tspeedup\n";
+    cout << "scc\t1\t" << base_ms << "\t" << base.visits << "\t1.00\n";
+
+    for (unsigned t = 1; t <= max_threads; t *= 2) {
+        reaching_result r;
+        double ms = timed(solve_mode::parallel, t, r);
+        if (r.out != base.out || r.in != base.in || r.visits != base.visits) {
+            cerr << "parallel result with " << t << " threads differs from scc mode\n";
+            return 1;
+        }
+        cout << "parallel\t" << t << "\t" << ms << "\t" << r.visits << "\t" << base_ms / ms << "\n";
+        if (t < max_threads && t * 2 > max_threads) t = max_threads / 2; // end on max_threads
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include "analysis.hpp"
+#include <iostream>
+
+using namespace std;
+
+// Prints the in/out facts of one of the bit-vector analyses in dataflow.hpp.
+// usage: dataflow_util [reaching|live|avail] [--solver worklist|scc|parallel] [--threads N] [--stats] [-j N | --stream] [--func PATTERN]... [--text | --binary]
+// --stats prints each function's block visits to stderr
+// -j N analyzes N functions at a time; output stays in function order
+// --stream reads and analyzes one function at a time, keeping only that one in memory
+// --func PATTERN only decodes and analyzes functions with that name, or whose name
+//   matches it as a regex; may be repeated
+// --text / --binary read Bril's text syntax or the binary IR instead of json
+
+int main(int argc, char** argv) {
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    string which = "reaching";
+    solve_mode mode = solve_mode::worklist;
+    unsigned threads = 0; // parallel solver only; 0 = this function's share of the hardware
+    bool stats = false;
+    tool_input input;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "reaching" || arg == "live" || arg == "avail") {
+            which = arg;
+        } else if (arg == "--solver" && i + 1 < argc && solve_mode_from_name(argv[i + 1], mode)) {
+            ++i;
+        } else if (arg == "--threads" && i + 1 < argc && parse_number_flag(argv[i + 1], threads)) {
+            ++i;
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (parse_tool_input_flag(argc, argv, i, input)) {
+        } else {
+            cerr << "usage: " << argv[0] << " [reaching|live|avail] [--solver worklist|scc|parallel] [--threads N] [--stats] " << tool_input_usage << "\n";
+            return 1;
+        }
+    }
+
+    threads = threads_per_function(input, threads);
+    analysis_options opts;
+    opts.solver = mode;
+    opts.threads = threads;
+    auto analyze = [&](const bril_function& func, ostream& out, ostream& err) {
+        function_analyses fa(func, opts);
+        const cfg_info& cfg = fa.cfg();
+
+        dataflow_result avail;
+        if (which == "avail") avail = available_expressions(func, fa.blocks(), cfg, mode, threads);
+        const dataflow_result& r = which == "reaching" ? fa.reaching() : which == "live" ? fa.liveness() : avail;
+        if (stats) {
+            err << sym_name(func.name) << ": " << r.visits << " block visits, " << cfg.size() << " blocks\n";
+        }
+
+        auto print = [&](const char* what, const bitvec& facts) {
+            out << "  " << what << ":";
+            facts.for_each([&](size_t i) { out << " [" << r.names[i] << "]"; });
+            out << "\n";
+        };
+        for (block_id b = 0; b < cfg.size(); ++b) {
+            out << "Block " << sym_name(cfg.labels[b]) << ":\n";
+            print("in", r.in[b]);
+            print("out", r.out[b]);
+        }
+    };
+
+    analyze_functions(cin, input, analyze);
+}
@@ -0,0 +1,131 @@
+#include "dominators.hpp"
+#include "passes.hpp"
+#include <chrono>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+// Compares the dominator engines on generated CFGs of increasing size, and
+// times to_ssa on the chains.
+// usage: dom_bench [max_blocks]
+//
+// shapes:
+//   random - every block branches to the next block and to a random block
+//            anywhere in the function, so most loops are irreducible
+//   nested - one loop nested inside the next, half the blocks deep; the
+//            idom chains are as long as the function
+//   chain  - every block assigns c and jumps to the next, so the dominator
+//            tree is a single path and to_ssa renames down all of it
+
+static sym label_name(size_t i) { return intern("b" + to_string(i)); }
+
+static void add_label(bril_function& func, sym l) {
+    instr i;
+    i.op = opcode::label;
+    i.label = l;
+    func.instrs.push_back(i);
+}
+
+static void add_jump(bril_function& func, sym cond, sym t, sym f) {
+    instr i;
+    i.present = instr::HAS_LABELS;
+    if (f == no_sym) {
+        i.op = opcode::jmp;
+        i.labels = func.add_operands({t});
+    } else {
+        i.op = opcode::br;
+        i.present |= instr::HAS_ARGS;
+        i.args = func.add_operands({cond});
+        i.labels = func.add_operands({t, f});
+    }
+    func.instrs.push_back(i);
+}
+
+static bril_function gen_function(const string& shape, size_t n, uint32_t seed) {
+    bril_function func;
+    func.name = intern("bench");
+    sym cond = intern("c");
+    sym end = intern("end");
+
+    instr c;
+    c.op = opcode::const_;
+    c.dest = cond;
+    c.type = intern("bool");
+    c.value.kind = literal::bool_;
+    c.value.b = true;
+    func.instrs.push_back(c);
+
+    mt19937 rng(seed);
+    size_t loops = n / 2;
+    for (size_t i = 0; i < n; ++i) {
+        add_label(func, label_name(i));
+        sym next = i + 1 < n ? label_name(i + 1) : end;
+        if (shape == "chain") {
+            func.instrs.push_back(c);
+            add_jump(func, cond, next, no_sym);
+        } else if (shape == "random") {
+            add_jump(func, cond, next, label_name(rng() % n));
+        } else if (i < loops) {
+            add_jump(func, cond, next, no_sym); // loop header: into the next loop
+        } else {
+            add_jump(func, cond, label_name(n - 1 - i), next); // latch: back edge or out
+        }
+    }
+    add_label(func, end);
+    instr r;
+    r.op = opcode::ret;
+    func.instrs.push_back(r);
+    return func;
+}
+
+static double time_ms(const cfg_info& cfg, dom_engine engine, vector<block_id>& idom) {
+    auto start = chrono::steady_clock::now();
+    idom = immediate_dominators(cfg, engine);
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// to_ssa reports every block it renames; keep that out of the timings
+struct null_buffer : streambuf {
+    int overflow(int c) override { return c; }
+};
+
+static double to_ssa_ms(const bril_function& func) {
+    program prog;
+    prog.functions.push_back(func);
+    null_buffer quiet;
+    streambuf* saved = cerr.rdbuf(&quiet);
+    auto start = chrono::steady_clock::now();
+    run_pipeline(prog, {find_pass("to_ssa")});
+    double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cerr.rdbuf(saved);
+    return ms;
+}
+
+int main(int argc, char** argv) {
+    size_t max_blocks = argc > 1 ? stoul(argv[1]) : 64000;
+
+    cout << "shape\tblocks\tchk_ms\tlt_ms\tto_ssa_ms\n";
+    for (string shape : {"random", "nested", "chain"}) {
+        for (size_t n = 1000; n <= max_blocks; n *= 4) {
+            bril_function func = gen_function(shape, n, 6120);
+            add_entry(func, gen_basic_blocks(func));
+            cfg_info cfg = build_cfg(func, gen_basic_blocks(func));
+
+            vector<block_id> chk, lt;
+            double chk_ms = time_ms(cfg, dom_engine::chk, chk);
+            double lt_ms = time_ms(cfg, dom_engine::semi_nca, lt);
+            if (chk != lt) {
+                cerr << "engines disagree on " << shape << " with " << n << " blocks\n";
+                return 1;
+            }
+            cout << shape << "\t" << cfg.size() << "\t" << chk_ms << "\t" << lt_ms << "\t";
+            if (shape == "chain") {
+                cout << to_ssa_ms(func) << "\n";
+            } else {
+                cout << "-\n";
+            }
+        }
+    }
+    return 0;
+}
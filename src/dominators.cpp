@@ -0,0 +1,219 @@
+#include "dominators.hpp"
+
+using namespace std;
+
+// idom = {entry -> entry, everything else -> undefined}
+// while idom is still changing:
+//     for b in reverse postorder except entry:
+//         new_idom = first processed predecessor of b
+//         for every other processed predecessor p:
+//             new_idom = intersect(p, new_idom)
+//         idom[b] = new_idom
+// intersect walks the two idom chains up towards the entry, always moving
+// the finger that is later in reverse postorder, until they meet.
+static vector<block_id> chk_idoms(const cfg_info& cfg) {
+    const size_t n = cfg.size();
+    vector<block_id> idom(n, no_block);
+    if (n == 0) return idom;
+
+    const block_id entry = 0;
+    idom[entry] = entry;
+
+    auto intersect = [&](block_id a, block_id b) {
+        while (a != b) {
+            while (cfg.rpo_index[a] > cfg.rpo_index[b]) a = idom[a];
+            while (cfg.rpo_index[b] > cfg.rpo_index[a]) b = idom[b];
+        }
+        return a;
+    };
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (block_id b : cfg.rpo) {
+            if (b == entry) continue;
+
+            block_id new_idom = no_block;
+            for (block_id p : cfg.predecessors(b)) {
+                if (idom[p] == no_block) continue; // not processed yet, or unreachable
+                new_idom = new_idom == no_block ? p : intersect(p, new_idom);
+            }
+
+            if (new_idom != idom[b]) {
+                idom[b] = new_idom;
+                changed = true;
+            }
+        }
+    }
+
+    return idom;
+}
+
+// preorder numbers from a DFS of the entry; everything below works on those
+// numbers, with semi[i] the semidominator of vertex i:
+// for i in preorder, last to first:
+//     for each predecessor p of vertex i:
+//         semi[i] = min(semi[i], semi[eval(p)])
+//     link(parent[i], i)
+// for i in preorder, first to last:
+//     idom[i] = parent[i]
+//     while idom[i] > semi[i]: idom[i] = idom[idom[i]]
+// eval(v) is the vertex of minimum semi on the forest path above v, kept
+// short by path compression.
+static vector<block_id> semi_nca_idoms(const cfg_info& cfg) {
+    const size_t n = cfg.size();
+    vector<block_id> idom(n, no_block);
+    if (n == 0) return idom;
+
+    const uint32_t none = UINT32_MAX;
+    arena_vector<uint32_t> pre(n, none); // block id -> preorder number
+    arena_vector<block_id> vertex;       // preorder number -> block id
+    arena_vector<uint32_t> parent;       // preorder numbers
+    vertex.reserve(cfg.rpo.size());
+    parent.reserve(cfg.rpo.size());
+
+    // iterative so that long chains can't overflow the stack
+    arena_vector<pair<block_id, uint32_t>> stack; // (block, next successor slot)
+    pre[0] = 0;
+    vertex.push_back(0);
+    parent.push_back(0);
+    stack.push_back({0, cfg.succ_off[0]});
+    while (!stack.empty()) {
+        auto& [b, next] = stack.back();
+        if (next == cfg.succ_off[b + 1]) {
+            stack.pop_back();
+            continue;
+        }
+        block_id s = cfg.succ[next++];
+        if (pre[s] != none) continue;
+        pre[s] = vertex.size();
+        parent.push_back(pre[b]);
+        vertex.push_back(s);
+        stack.push_back({s, cfg.succ_off[s]});
+    }
+
+    const uint32_t count = vertex.size();
+    arena_vector<uint32_t> semi(count), label(count), ancestor(count, none);
+    for (uint32_t i = 0; i < count; ++i) semi[i] = label[i] = i;
+
+    arena_vector<uint32_t> path;
+    auto eval = [&](uint32_t v) {
+        if (ancestor[v] == none) return v;
+        // compress(v), without recursion
+        path.clear();
+        for (uint32_t x = v; ancestor[ancestor[x]] != none; x = ancestor[x]) path.push_back(x);
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            uint32_t x = *it, a = ancestor[x];
+            if (semi[label[a]] < semi[label[x]]) label[x] = label[a];
+            ancestor[x] = ancestor[a];
+        }
+        return label[v];
+    };
+
+    for (uint32_t i = count - 1; i > 0; --i) {
+        for (block_id p : cfg.predecessors(vertex[i])) {
+            if (pre[p] == none) continue; // unreachable
+            semi[i] = min(semi[i], semi[eval(pre[p])]);
+        }
+        ancestor[i] = parent[i];
+    }
+
+    arena_vector<uint32_t> dom(count);
+    dom[0] = 0;
+    for (uint32_t i = 1; i < count; ++i) {
+        uint32_t d = parent[i];
+        while (d > semi[i]) d = dom[d];
+        dom[i] = d;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) idom[vertex[i]] = vertex[dom[i]];
+    return idom;
+}
+
+vector<block_id> immediate_dominators(const cfg_info& cfg, dom_engine engine) {
+    return engine == dom_engine::semi_nca ? semi_nca_idoms(cfg) : chk_idoms(cfg);
+}
+
+bool dom_engine_from_name(const string& name, dom_engine& out) {
+    if (name == "chk") out = dom_engine::chk;
+    else if (name == "lt" || name == "semi-nca") out = dom_engine::semi_nca;
+    else return false;
+    return true;
+}
+
+vector<block_id> dominators_of(const vector<block_id>& idom, block_id b) {
+    vector<block_id> doms{b};
+    while (idom[b] != no_block && idom[b] != b) {
+        b = idom[b];
+        doms.push_back(b);
+    }
+    return doms;
+}
+
+dominator_tree build_dom_tree(const vector<block_id>& idom) {
+    const size_t n = idom.size();
+    dominator_tree t;
+    t.idom = idom;
+
+    auto has_parent = [&](block_id b) { return idom[b] != no_block && idom[b] != b; };
+
+    // children CSR, in block id order
+    t.kid_off.assign(n + 1, 0);
+    for (block_id b = 0; b < n; ++b) {
+        if (has_parent(b)) ++t.kid_off[idom[b] + 1];
+    }
+    for (size_t b = 0; b < n; ++b) t.kid_off[b + 1] += t.kid_off[b];
+    t.kid.resize(t.kid_off[n]);
+    arena_vector<uint32_t> fill(t.kid_off.begin(), t.kid_off.end() - 1);
+    for (block_id b = 0; b < n; ++b) {
+        if (has_parent(b)) t.kid[fill[idom[b]]++] = b;
+    }
+
+    // entry/exit numbers, DFS from the entry
+    t.enter.assign(n, no_block);
+    t.exit.assign(n, no_block);
+    uint32_t clock = 0;
+    arena_vector<pair<block_id, uint32_t>> stack; // (block, next child slot)
+    if (n > 0 && idom[0] == 0) {
+        t.enter[0] = clock++;
+        stack.push_back({0, t.kid_off[0]});
+        while (!stack.empty()) {
+            auto& [b, next] = stack.back();
+            if (next == t.kid_off[b + 1]) {
+                t.exit[b] = clock++;
+                stack.pop_back();
+                continue;
+            }
+            block_id c = t.kid[next++];
+            t.enter[c] = clock++;
+            stack.push_back({c, t.kid_off[c]});
+        }
+    }
+
+    return t;
+}
+
+// for every join point b, walk up the tree from each predecessor until
+// reaching a strict dominator of b; b is in the frontier of every block
+// passed on the way. An unreachable predecessor has no idom, so only it
+// gets b in its frontier.
+vector<vector<block_id>> dominance_frontier(const cfg_info& cfg, const dominator_tree& tree) {
+    const auto& idom = tree.idom;
+    const size_t n = cfg.size();
+    vector<vector<block_id>> df(n);
+
+    for (block_id b = 0; b < n; ++b) {
+        auto preds = cfg.predecessors(b);
+        if (preds.size() < 2) continue;
+        for (block_id p : preds) {
+            block_id runner = p;
+            while (runner != no_block && !tree.strictly_dominates(runner, b)) {
+                if (df[runner].empty() || df[runner].back() != b) df[runner].push_back(b);
+                block_id up = idom[runner];
+                runner = up == runner ? no_block : up;
+            }
+        }
+    }
+
+    return df;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "common.hpp"
+
+// Dominance over a cfg_info, shared by dominator_util and to_ssa.
+//
+// Two engines compute the same immediate dominators:
+//  - chk: Cooper, Harvey & Kennedy, "A Simple, Fast Dominance Algorithm".
+//    Iterates over reverse postorder, intersecting predecessors by walking
+//    up the current idom chains. Fast on typical, shallow CFGs.
+//  - semi_nca: the semi-NCA variant of Lengauer-Tarjan (Georgiadis, 2005).
+//    Computes semidominators with path compression in one reverse-preorder
+//    sweep, then idoms by a nearest-common-ancestor walk. Near-linear, so it
+//    holds up on huge, deeply nested or irreducible CFGs.
+// idom[entry] == entry; blocks unreachable from the entry get no_block.
+enum class dom_engine { chk, semi_nca };
+
+std::vector<block_id> immediate_dominators(const cfg_info& cfg, dom_engine engine = dom_engine::chk);
+
+// "chk" / "lt" (or "semi-nca"); returns false for an unknown name
+bool dom_engine_from_name(const std::string& name, dom_engine& out);
+
+// Every dominator of b, from b itself up to the entry. An unreachable block
+// is only dominated by itself.
+std::vector<block_id> dominators_of(const std::vector<block_id>& idom, block_id b);
+
+// Dominator tree over block ids. Children are stored in CSR form, in block
+// id order. Every reachable block gets DFS entry/exit numbers, so a
+// dominates b iff a's [enter, exit] interval contains b's. Unreachable
+// blocks have no numbers and only dominate themselves.
+struct dominator_tree {
+    std::vector<block_id> idom;
+    std::vector<uint32_t> kid_off;
+    std::vector<block_id> kid;
+    std::vector<uint32_t> enter; // no_block if unreachable
+    std::vector<uint32_t> exit;
+
+    size_t size() const { return idom.size(); }
+    id_span<const block_id> children(block_id b) const { return {kid.data() + kid_off[b], kid.data() + kid_off[b + 1]}; }
+    bool dominates(block_id a, block_id b) const {
+        if (a == b) return true;
+        if (enter[a] == no_block || enter[b] == no_block) return false;
+        return enter[a] <= enter[b] && exit[b] <= exit[a];
+    }
+    bool strictly_dominates(block_id a, block_id b) const { return a != b && dominates(a, b); }
+};
+
+// O(n): counting sort of blocks by idom, then one iterative DFS for the
+// numbering.
+dominator_tree build_dom_tree(const std::vector<block_id>& idom);
+
+// DF(x) = blocks y such that x dominates a predecessor of y but does not
+// strictly dominate y. Each frontier is in block id order, without repeats.
+std::vector<std::vector<block_id>> dominance_frontier(const cfg_info& cfg, const dominator_tree& tree);
@@ -0,0 +1,765 @@
+#include "common.hpp"
+#include <charconv>
+#include <iostream>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// Fast json front end, selected at build time with `make JSON=simd`:
+// read_program_simd parses json text straight into the pass IR, scanning
+// strings and whitespace 16 bytes at a time, and write_program_compact prints
+// the IR without building a nlohmann::json. Both give exactly what the
+// nlohmann path would; the rare fields the IR does not model (e.g. "pos")
+// still go through nlohmann::json.
+
+// ---------------------------------------------------------------------------
+// Scanning: SSE2 on x86-64, NEON on arm64, a byte at a time elsewhere and for
+// the last few bytes of the input.
+// ---------------------------------------------------------------------------
+
+namespace
+{
+
+bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+// the first byte at or after p that is not whitespace, or end
+const char *skip_space(const char *p, const char *end)
+{
+    if (p < end && !is_space(*p))
+        return p;
+#if defined(__SSE2__)
+    const __m128i sp = _mm_set1_epi8(' '), tab = _mm_set1_epi8('\t'), nl = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        __m128i ws = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, tab)),
+                                  _mm_or_si128(_mm_cmpeq_epi8(v, nl), _mm_cmpeq_epi8(v, cr)));
+        unsigned other = ~_mm_movemask_epi8(ws) & 0xffff;
+        if (other)
+            return p + __builtin_ctz(other);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; end - p >= 16; p += 16)
+    {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+        uint8x16_t ws = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8(' ')), vceqq_u8(v, vdupq_n_u8('\t'))),
+                                 vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')), vceqq_u8(v, vdupq_n_u8('\r'))));
+        if (vminvq_u8(ws) == 0)
+            break; // the loop below finds which byte
+    }
+#endif
+    while (p < end && is_space(*p))
+        ++p;
+    return p;
+}
+
+// The first byte at or after p, inside a string, that needs a closer look: a
+// quote, a backslash, a control character or a non-ASCII byte (nlohmann
+// checks the UTF-8), or end.
+const char *string_stop(const char *p, const char *end)
+{
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"'), backslash = _mm_set1_epi8('\\'), control = _mm_set1_epi8(0x1f);
+    for (; end - p >= 16; p += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        // max(v, 0x1f) == 0x1f picks out the control characters; movemask of
+        // v itself the bytes with the top bit set
+        __m128i stop = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                    _mm_cmpeq_epi8(_mm_max_epu8(v, control), control));
+        unsigned mask = _mm_movemask_epi8(stop) | _mm_movemask_epi8(v);
+        if (mask)
+            return p + __builtin_ctz(mask);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; end - p >= 16; p += 16)
+    {
+        uint8x16_t v = vld1q_u8(reinterpret_cast<const uint8_t *>(p));
+        uint8x16_t stop = vorrq_u8(vorrq_u8(vceqq_u8(v, vdupq_n_u8('"')), vceqq_u8(v, vdupq_n_u8('\\'))),
+                                   vorrq_u8(vcltq_u8(v, vdupq_n_u8(0x20)), vcgtq_u8(v, vdupq_n_u8(0x7f))));
+        if (vmaxvq_u8(stop) != 0)
+            break; // the loop below finds which byte
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20 && (unsigned char)*p < 0x80)
+        ++p;
+    return p;
+}
+
+// ---------------------------------------------------------------------------
+// Loader. Mirrors program_from_json, function_from_json and instr_from_json
+// field by field. Input it does not model (a repeated Bril field, an
+// instruction that is not an object, malformed json) is not_fast, and the
+// whole input goes to nlohmann instead, which also reports any error.
+// ---------------------------------------------------------------------------
+
+struct not_fast
+{
+};
+
+enum instr_field { LABEL, OP, DEST, TYPE, ARGS, FUNCS, LABELS, VALUE, INSTR_FIELDS };
+const std::string_view instr_field_names[INSTR_FIELDS] = {"label", "op",    "dest",   "type",
+                                                          "args",  "funcs", "labels", "value"};
+
+class json_loader
+{
+public:
+    explicit json_loader(std::string_view src) : p_(src.data()), end_(src.data() + src.size()) {}
+
+    program load()
+    {
+        program prog;
+        bool has_functions = false;
+        expect('{');
+        if (!take('}'))
+        {
+            do
+            {
+                std::string key(string());
+                expect(':');
+                if (key == "functions")
+                {
+                    if (has_functions || peek() != '[')
+                        throw not_fast{};
+                    has_functions = true;
+                    functions(prog.functions);
+                }
+                else
+                    prog.extra[key] = value_json();
+            } while (take(','));
+            expect('}');
+        }
+        if (skip_space(p_, end_) != end_)
+            throw not_fast{};
+        return prog;
+    }
+
+private:
+    char peek()
+    {
+        p_ = skip_space(p_, end_);
+        if (p_ == end_)
+            throw not_fast{};
+        return *p_;
+    }
+
+    bool take(char c)
+    {
+        if (peek() != c)
+            return false;
+        ++p_;
+        return true;
+    }
+
+    void expect(char c)
+    {
+        if (!take(c))
+            throw not_fast{};
+    }
+
+    bool word(std::string_view w)
+    {
+        if ((size_t)(end_ - p_) < w.size() || std::string_view(p_, w.size()) != w)
+            return false;
+        p_ += w.size();
+        return true;
+    }
+
+    // A view of the input when the string is plain ASCII with no escapes;
+    // otherwise nlohmann decodes it into scratch_, so use the result before
+    // reading the next string.
+    std::string_view string()
+    {
+        if (peek() != '"')
+            throw not_fast{};
+        const char *start = ++p_;
+        bool plain = true;
+        for (p_ = string_stop(p_, end_); p_ < end_ && *p_ != '"'; p_ = string_stop(p_, end_))
+        {
+            if ((unsigned char)*p_ < 0x20 || (*p_ == '\\' && ++p_ == end_))
+                throw not_fast{};
+            plain = false;
+            ++p_;
+        }
+        if (p_ == end_)
+            throw not_fast{};
+        ++p_;
+        if (plain)
+            return std::string_view(start, p_ - 1 - start);
+        scratch_ = json::parse(start - 1, p_).get<std::string>();
+        return scratch_;
+    }
+
+    static bool is_delimiter(char c)
+    {
+        switch (c)
+        {
+        case '"': case ',': case ':': case '[': case ']': case '{': case '}': return true;
+        default: return false;
+        }
+    }
+
+    // The next value as nlohmann parses it, for the fields the IR does not
+    // model. Finds the end without recursing, then parses just that span.
+    json value_json()
+    {
+        peek();
+        const char *start = p_;
+        int depth = 0;
+        do
+        {
+            char c = peek();
+            if (c == '"')
+                string();
+            else if (c == '{' || c == '[')
+            {
+                ++depth;
+                ++p_;
+            }
+            else if (c == '}' || c == ']')
+            {
+                --depth;
+                ++p_;
+            }
+            else if (c == ',' || c == ':')
+                ++p_;
+            else
+                while (p_ < end_ && !is_space(*p_) && !is_delimiter(*p_))
+                    ++p_;
+        } while (depth > 0);
+        if (depth < 0)
+            throw not_fast{};
+        return json::parse(start, p_);
+    }
+
+    // type_from_json
+    sym type()
+    {
+        if (peek() == '"')
+            return intern(string());
+        return intern(value_json().dump());
+    }
+
+    // literal_from_json: nlohmann reads integers as unsigned unless they are
+    // negative, and anything with a fraction or exponent as a double
+    bool literal_value(literal &lit)
+    {
+        char c = peek();
+        if (c == '"')
+        {
+            lit.kind = literal::char_;
+            lit.c = intern(string());
+            return true;
+        }
+        if (c == 't' || c == 'f')
+        {
+            if (!word(c == 't' ? "true" : "false"))
+                throw not_fast{};
+            lit.kind = literal::bool_;
+            lit.b = c == 't';
+            return true;
+        }
+        if (c != '-' && (c < '0' || c > '9'))
+            return false;
+
+        bool negative = c == '-';
+        const char *digits = p_ + negative, *q = digits;
+        while (q < end_ && *q >= '0' && *q <= '9')
+            ++q;
+        if (q > digits && q - digits <= 18 && (*digits != '0' || q - digits == 1) &&
+            (q == end_ || (*q != '.' && *q != 'e' && *q != 'E')))
+        {
+            int64_t v = 0;
+            std::from_chars(digits, q, v);
+            p_ = q;
+            lit.kind = negative ? literal::int_ : literal::uint_;
+            if (negative)
+                lit.i = -v;
+            else
+                lit.u = v;
+            return true;
+        }
+        json v = value_json(); // big integers, fractions and exponents
+        if (v.is_number_unsigned())
+        {
+            lit.kind = literal::uint_;
+            lit.u = v.get<uint64_t>();
+        }
+        else if (v.is_number_integer())
+        {
+            lit.kind = literal::int_;
+            lit.i = v.get<int64_t>();
+        }
+        else
+        {
+            lit.kind = literal::float_;
+            lit.f = v.get<double>();
+        }
+        return true;
+    }
+
+    // names_from_json: an array of strings into `out`, or false (having read
+    // nothing) for anything else
+    bool names(std::vector<sym> &out)
+    {
+        out.clear();
+        const char *start = p_;
+        if (!take('['))
+            return false;
+        if (take(']'))
+            return true;
+        do
+        {
+            if (peek() != '"')
+            {
+                p_ = start;
+                return false;
+            }
+            out.push_back(intern(string()));
+        } while (take(','));
+        expect(']');
+        return true;
+    }
+
+    void functions(std::vector<bril_function> &out)
+    {
+        expect('[');
+        if (take(']'))
+            return;
+        do
+            out.push_back(function());
+        while (take(','));
+        expect(']');
+    }
+
+    bril_function function()
+    {
+        enum { NAME = 1, FUNC_TYPE = 2, FUNC_ARGS = 4, INSTRS = 8 };
+        bril_function func;
+        unsigned seen = 0;
+        expect('{');
+        if (!take('}'))
+        {
+            do
+            {
+                std::string key(string());
+                int f = key == "name" ? NAME : key == "type" ? FUNC_TYPE : key == "args" ? FUNC_ARGS : key == "instrs" ? INSTRS : 0;
+                if (seen & f)
+                    throw not_fast{}; // nlohmann keeps the last one
+                seen |= f;
+                expect(':');
+                char c = peek();
+                if (f == NAME && c == '"')
+                    func.name = intern(string());
+                else if (f == FUNC_TYPE)
+                    func.type = type();
+                else if (f == FUNC_ARGS && c == '[')
+                {
+                    func.has_args = true;
+                    args(func);
+                }
+                else if (f == INSTRS && c == '[')
+                    instrs(func);
+                else
+                    func.extra[key] = value_json();
+            } while (take(','));
+            expect('}');
+        }
+        return func;
+    }
+
+    // each arg must have a string "name" and a "type", as a.at() demands
+    void args(bril_function &func)
+    {
+        expect('[');
+        if (take(']'))
+            return;
+        do
+        {
+            sym arg_name = no_sym, arg_type = no_sym;
+            bool has_name = false, has_type = false;
+            expect('{');
+            if (!take('}'))
+            {
+                do
+                {
+                    std::string_view key = string();
+                    bool is_name = key == "name", is_type = key == "type";
+                    expect(':');
+                    if (is_name)
+                    {
+                        if (peek() != '"')
+                            throw not_fast{};
+                        arg_name = intern(string());
+                        has_name = true;
+                    }
+                    else if (is_type)
+                    {
+                        arg_type = type();
+                        has_type = true;
+                    }
+                    else
+                        value_json();
+                } while (take(','));
+                expect('}');
+            }
+            if (!has_name || !has_type)
+                throw not_fast{};
+            func.args.push_back({arg_name, arg_type});
+        } while (take(','));
+        expect(']');
+    }
+
+    void instrs(bril_function &func)
+    {
+        expect('[');
+        if (take(']'))
+            return;
+        do
+        {
+            if (peek() != '{')
+                throw not_fast{}; // not a Bril instruction; nlohmann decides
+            func.instrs.push_back(instruction(func));
+        } while (take(','));
+        expect(']');
+    }
+
+    // Fields may come in any order; they are applied in the order of
+    // nlohmann's sorted keys, so the operand pool comes out the same.
+    instr instruction(bril_function &func)
+    {
+        instr i;
+        i.op = opcode::unknown;
+        opcode op = opcode::unknown;
+        bool op_is_string = false;
+        json rest; // becomes an object with the first field kept
+        unsigned seen = 0;
+        bool has_names[3] = {};
+
+        expect('{');
+        if (!take('}'))
+        {
+            do
+            {
+                std::string_view key = string();
+                int f = 0;
+                while (f < INSTR_FIELDS && key != instr_field_names[f])
+                    ++f;
+                std::string other_key;
+                if (f == INSTR_FIELDS)
+                    other_key = key;
+                else if (seen & 1u << f)
+                    throw not_fast{}; // nlohmann keeps the last one
+                seen |= 1u << f;
+                expect(':');
+
+                char c = peek();
+                switch (f)
+                {
+                case LABEL:
+                    if (c == '"')
+                    {
+                        i.op = opcode::label;
+                        i.label = intern(string());
+                    }
+                    else
+                        rest["label"] = value_json();
+                    break;
+                case OP:
+                    if (c == '"')
+                    {
+                        op_name_ = string();
+                        op = opcode_from_name(op_name_);
+                        op_is_string = true;
+                    }
+                    else
+                        rest["op"] = value_json();
+                    break;
+                case DEST:
+                    if (c == '"')
+                        i.dest = intern(string());
+                    else
+                        rest["dest"] = value_json();
+                    break;
+                case TYPE:
+                    i.type = type();
+                    break;
+                case ARGS:
+                case FUNCS:
+                case LABELS:
+                    has_names[f - ARGS] = names(names_[f - ARGS]);
+                    if (!has_names[f - ARGS])
+                        rest[std::string(instr_field_names[f])] = value_json();
+                    break;
+                case VALUE:
+                    if (!literal_value(i.value))
+                        rest["value"] = value_json();
+                    break;
+                default:
+                    rest[other_key] = value_json();
+                }
+            } while (take(','));
+            expect('}');
+        }
+
+        if (op_is_string)
+        {
+            if (!i.is_label() && op != opcode::unknown)
+                i.op = op;
+            else
+                rest["op"] = op_name_;
+        }
+        operand_list *lists[3] = {&i.args, &i.funcs, &i.labels};
+        const uint8_t present[3] = {instr::HAS_ARGS, instr::HAS_FUNCS, instr::HAS_LABELS};
+        for (int k = 0; k < 3; ++k)
+        {
+            if (!has_names[k])
+                continue;
+            *lists[k] = func.add_operands(names_[k].data(), names_[k].size());
+            i.present |= present[k];
+        }
+        if (!rest.is_null())
+        {
+            i.extra = (int32_t)func.extras.size();
+            func.extras.push_back(std::move(rest));
+        }
+        return i;
+    }
+
+    const char *p_, *end_;
+    std::string scratch_;        // the last string with escapes, decoded
+    std::string op_name_;        // the instruction's "op", if a string
+    std::vector<sym> names_[3];  // its args, funcs and labels
+};
+
+} // namespace
+
+program read_program_simd(std::string_view input)
+{
+    try
+    {
+        return json_loader(input).load();
+    }
+    catch (const not_fast &)
+    {
+    }
+    catch (const json::exception &)
+    {
+    }
+    return program_from_json(json::parse(input));
+}
+
+// ---------------------------------------------------------------------------
+// Compact writer. nlohmann objects are std::maps, so every object is written
+// with its keys in sorted order, and strings are escaped the same way.
+// ---------------------------------------------------------------------------
+
+static void put_string(std::string &out, std::string_view s)
+{
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    size_t start = 0;
+    for (size_t k = 0; k < s.size(); ++k)
+    {
+        unsigned char c = s[k];
+        if (c >= 0x20 && c != '"' && c != '\\')
+            continue;
+        out.append(s.data() + start, k - start);
+        start = k + 1;
+        switch (c)
+        {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default:
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 15];
+        }
+    }
+    out.append(s.data() + start, s.size() - start);
+    out += '"';
+}
+
+template <typename T>
+static void put_number(std::string &out, T v)
+{
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof buf, v);
+    out.append(buf, res.ptr);
+}
+
+// parameterized types are already interned as compact, sorted json
+static void put_type(std::string &out, sym t)
+{
+    const std::string &s = sym_name(t);
+    if (!s.empty() && s[0] == '{')
+        out += s;
+    else
+        put_string(out, s);
+}
+
+static void put_names(std::string &out, id_span<const sym> names)
+{
+    out += '[';
+    bool first = true;
+    for (sym s : names)
+    {
+        if (!first)
+            out += ',';
+        first = false;
+        put_string(out, sym_name(s));
+    }
+    out += ']';
+}
+
+static void put_literal(std::string &out, const literal &lit)
+{
+    switch (lit.kind)
+    {
+    case literal::int_: put_number(out, lit.i); break;
+    case literal::uint_: put_number(out, lit.u); break;
+    case literal::float_: out += json(lit.f).dump(); break; // nlohmann's own float format
+    case literal::bool_: out += lit.b ? "true" : "false"; break;
+    case literal::char_: put_string(out, sym_name(lit.c)); break;
+    default: out += "null";
+    }
+}
+
+// keys in sorted order: args dest funcs label labels op type value
+static void put_instr(std::string &out, const bril_function &func, const instr &i)
+{
+    if (i.extra >= 0)
+    {
+        out += instr_to_json(func, i).dump(); // extra keys interleave with ours
+        return;
+    }
+    char sep = '{';
+    auto key = [&](const char *k)
+    {
+        out += sep;
+        sep = ',';
+        out += '"';
+        out += k;
+        out += "\":";
+    };
+    if (i.present & instr::HAS_ARGS)
+    {
+        key("args");
+        put_names(out, func.args_of(i));
+    }
+    if (i.dest != no_sym)
+    {
+        key("dest");
+        put_string(out, sym_name(i.dest));
+    }
+    if (i.present & instr::HAS_FUNCS)
+    {
+        key("funcs");
+        put_names(out, func.funcs_of(i));
+    }
+    if (i.is_label())
+    {
+        key("label");
+        put_string(out, sym_name(i.label));
+    }
+    if (i.present & instr::HAS_LABELS)
+    {
+        key("labels");
+        put_names(out, func.labels_of(i));
+    }
+    if (!i.is_label() && i.op != opcode::unknown)
+    {
+        key("op");
+        put_string(out, opcode_name(i.op));
+    }
+    if (i.type != no_sym)
+    {
+        key("type");
+        put_type(out, i.type);
+    }
+    if (i.value.kind != literal::none)
+    {
+        key("value");
+        put_literal(out, i.value);
+    }
+    out += sep == '{' ? "{}" : "}";
+}
+
+// keys in sorted order: args instrs name type
+static void put_function(std::string &out, const bril_function &func)
+{
+    if (!func.extra.empty())
+    {
+        out += function_to_json(func).dump();
+        return;
+    }
+    out += '{';
+    if (func.has_args)
+    {
+        out += "\"args\":[";
+        for (size_t k = 0; k < func.args.size(); ++k)
+        {
+            if (k)
+                out += ',';
+            out += "{\"name\":";
+            put_string(out, sym_name(func.args[k].name));
+            out += ",\"type\":";
+            put_type(out, func.args[k].type);
+            out += '}';
+        }
+        out += "],";
+    }
+    out += "\"instrs\":[";
+    for (size_t k = 0; k < func.instrs.size(); ++k)
+    {
+        if (k)
+            out += ',';
+        put_instr(out, func, func.instrs[k]);
+    }
+    out += ']';
+    if (func.name != no_sym)
+    {
+        out += ",\"name\":";
+        put_string(out, sym_name(func.name));
+    }
+    if (func.type != no_sym)
+    {
+        out += ",\"type\":";
+        put_type(out, func.type);
+    }
+    out += '}';
+}
+
+void write_program_compact(std::ostream &out, const program &prog)
+{
+    if (!prog.extra.empty())
+    {
+        out << program_to_json(prog).dump() << "\n";
+        return;
+    }
+    std::string buf = "{\"functions\":[";
+    for (size_t k = 0; k < prog.functions.size(); ++k)
+    {
+        if (k)
+            buf += ',';
+        put_function(buf, prog.functions[k]);
+        if (buf.size() > (1 << 16)) // flush per function once there is enough to write
+        {
+            out.write(buf.data(), buf.size());
+            buf.clear();
+        }
+    }
+    buf += "]}\n";
+    out.write(buf.data(), buf.size());
+}
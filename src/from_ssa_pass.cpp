@@ -0,0 +1,247 @@
+#include "passes.hpp"
+#include "dataflow.hpp"
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <map>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+using namespace std;
+
+// strip an SSA version suffix (`x.3` -> `x`)
+static sym base_name(sym s)
+{
+    const string &name = sym_name(s);
+    size_t dot = name.find('.');
+    return dot == string::npos ? s : intern(name.substr(0, dot));
+}
+
+// The SSA ops read as copies: `set s v` is `s = id v` at the end of the
+// predecessor, and `get` and `undef` do nothing. A set from an undef, or to
+// a shadow nothing gets any more, is no copy at all.
+struct ssa_copies
+{
+    unordered_map<sym, sym> types; // get dest -> its type
+    unordered_set<sym> undefined;  // undef dests
+
+    ssa_copies(const bril_function &func)
+    {
+        for (const auto &instr : func.instrs)
+        {
+            if (instr.op == opcode::get)
+                types[instr.dest] = instr.type;
+            else if (instr.op == opcode::undef)
+                undefined.insert(instr.dest);
+        }
+    }
+
+    bool is_copy(const bril_function &func, const instr &instr) const
+    {
+        if (instr.op != opcode::set || instr.args.len != 2)
+            return false;
+        auto args = func.args_of(instr);
+        return types.count(args[0]) && !undefined.count(args[1]);
+    }
+};
+
+// Bases whose versions can't all share the base name: two of them are live
+// at once. Plain to_ssa output never has these, but passes in between can
+// stretch a version's live range (lvn reusing x.0 after x.1 is assigned).
+// Copy sources don't count, since they hold the same value.
+static unordered_set<sym> interfering_bases(const bril_function &func, const vector<block> &blocks,
+                                            const cfg_info &cfg, const ssa_copies &copies)
+{
+    unordered_map<sym, uint32_t> var_ids;
+    vector<uint32_t> var_base; // var -> base id
+    unordered_map<sym, uint32_t> base_ids;
+    vector<sym> bases;
+    auto id_of = [&](sym v)
+    {
+        auto [it, added] = var_ids.emplace(v, (uint32_t)var_base.size());
+        if (added)
+        {
+            sym b = base_name(v);
+            auto [bit, new_base] = base_ids.emplace(b, (uint32_t)bases.size());
+            if (new_base)
+                bases.push_back(b);
+            var_base.push_back(bit->second);
+        }
+        return it->second;
+    };
+
+    // (def, copy source, uses) of an instruction in copy form
+    struct effect
+    {
+        uint32_t def = UINT32_MAX;
+        uint32_t src = UINT32_MAX;
+        vector<uint32_t> uses;
+    };
+    auto effect_of = [&](const instr &instr)
+    {
+        effect e;
+        if (opcode_extension(instr.op) == bril_extension::ssa)
+        {
+            if (copies.is_copy(func, instr))
+            {
+                auto args = func.args_of(instr);
+                e.def = id_of(args[0]);
+                e.src = id_of(args[1]);
+                e.uses.push_back(e.src);
+            }
+            return e;
+        }
+        for (sym a : func.args_of(instr))
+            e.uses.push_back(id_of(a));
+        if (instr.has_dest())
+            e.def = id_of(instr.dest);
+        if (instr.op == opcode::id && !e.uses.empty())
+            e.src = e.uses[0];
+        return e;
+    };
+
+    vector<vector<effect>> effects(blocks.size());
+    for (block_id b = 0; b < blocks.size(); ++b)
+    {
+        for (const auto &instr : func.instrs_of(blocks[b]))
+            effects[b].push_back(effect_of(instr));
+    }
+    const size_t width = var_base.size();
+
+    gen_kill t(blocks.size(), width);
+    for (block_id b = 0; b < blocks.size(); ++b)
+    {
+        for (const effect &e : effects[b])
+        {
+            for (uint32_t u : e.uses)
+            {
+                if (!t.kill[b].test(u))
+                    t.gen[b].set(u);
+            }
+            if (e.def != UINT32_MAX)
+                t.kill[b].set(e.def);
+        }
+    }
+    Dataflow<backward_analysis, may_lattice, gen_kill> solver(cfg, width, std::move(t));
+    solver.solve();
+
+    // walk each block backwards keeping count of the live versions of each base
+    vector<bool> interferes(bases.size());
+    for (block_id b = 0; b < blocks.size(); ++b)
+    {
+        bitvec live = solver.out(b);
+        vector<uint32_t> live_versions(bases.size());
+        for (uint32_t v = 0; v < width; ++v)
+        {
+            if (live.test(v))
+                ++live_versions[var_base[v]];
+        }
+        for (auto e = effects[b].rbegin(); e != effects[b].rend(); ++e)
+        {
+            if (e->def != UINT32_MAX)
+            {
+                uint32_t base = var_base[e->def];
+                uint32_t others = live_versions[base] - live.test(e->def);
+                if (e->src != UINT32_MAX && e->src != e->def && var_base[e->src] == base && live.test(e->src))
+                    --others;
+                if (others > 0)
+                    interferes[base] = true;
+                if (live.test(e->def))
+                {
+                    live.reset(e->def);
+                    --live_versions[base];
+                }
+            }
+            for (uint32_t u : e->uses)
+            {
+                if (!live.test(u))
+                {
+                    live.set(u);
+                    ++live_versions[var_base[u]];
+                }
+            }
+        }
+        // function args and anything read before it is assigned are live together at the entry
+        if (b == 0)
+        {
+            for (size_t base = 0; base < bases.size(); ++base)
+            {
+                if (live_versions[base] > 1)
+                    interferes[base] = true;
+            }
+        }
+    }
+
+    unordered_set<sym> result;
+    for (size_t base = 0; base < bases.size(); ++base)
+    {
+        if (interferes[base])
+            result.insert(bases[base]);
+    }
+    return result;
+}
+
+// Merges SSA versions back into their base names, except for the bases in
+// `keep`, whose versions stay apart and get a copy for every set.
+static void rewrite_from_ssa(bril_function &func, const vector<block> &blocks, const ssa_copies &copies,
+                             const unordered_set<sym> &keep, block_rewrite &edits)
+{
+    unordered_map<sym, sym> names;
+    auto name_of = [&](sym v)
+    {
+        auto [it, added] = names.emplace(v, v);
+        if (added)
+        {
+            sym base = base_name(v);
+            if (!keep.count(base))
+                it->second = base;
+        }
+        return it->second;
+    };
+
+    for (const auto &block : blocks)
+    {
+        for (uint32_t k = block.begin; k < block.end; ++k)
+        {
+            instr &instr = func.instrs[k];
+
+            if (opcode_extension(instr.op) == bril_extension::ssa)
+            {
+                auto args = func.args_of(instr);
+                if (!copies.is_copy(func, instr) || name_of(args[0]) == name_of(args[1]))
+                {
+                    edits.erase(k);
+                    continue;
+                }
+                sym dest = name_of(args[0]);
+                sym src = name_of(args[1]);
+                sym type = copies.types.at(args[0]);
+                instr = {};
+                instr.op = opcode::id;
+                instr.present = instr::HAS_ARGS;
+                instr.dest = dest;
+                instr.type = type;
+                instr.args = func.add_operands({src});
+                continue;
+            }
+
+            if (instr.has_dest())
+                instr.dest = name_of(instr.dest);
+            for (auto &arg : func.args_of(instr))
+                arg = name_of(arg);
+        }
+    }
+}
+
+void func_from_ssa(bril_function &func, function_analyses &fa)
+{
+    vector<block> blocks = fa.blocks();
+    ssa_copies copies(func);
+    unordered_set<sym> keep = interfering_bases(func, blocks, fa.cfg(), copies);
+
+    block_rewrite edits;
+    rewrite_from_ssa(func, blocks, copies, keep, edits);
+
+    rebuild_blocks(func, blocks, std::move(edits));
+}
@@ -0,0 +1,70 @@
+#include "common.hpp"
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+// Load/store throughput of the json front ends on one Bril program.
+// usage: json_bench FILE [reps]
+// Loads with nlohmann and with read_program_simd, writes
+// with nlohmann's dump() and with write_program_compact, prints MB/s, and
+// fails if the front ends disagree.
+
+// best of `reps` runs, in MB/s of input json
+static double mb_per_s(size_t bytes, int reps, const function<void()>& op) {
+    double best = 1e300;
+    for (int r = 0; r < reps; ++r) {
+        auto start = chrono::steady_clock::now();
+        op();
+        best = min(best, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    }
+    return bytes / best / 1e6;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        cerr << "usage: json_bench FILE [reps]\n";
+        return 1;
+    }
+    ifstream file(argv[1], ios::binary);
+    string input((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    int reps = argc > 2 ? stoi(argv[2]) : 5;
+
+    program prog;
+    double load_nlohmann = mb_per_s(input.size(), reps, [&] { prog = program_from_json(json::parse(input)); });
+    string expected = program_to_json(prog).dump() + "\n";
+    size_t bytes = expected.size(); // store rates are per byte written
+
+    cout << "input\t" << input.size() << " bytes, " << prog.functions.size() << " functions\n";
+    cout << "op\tfront end\tMB/s\n";
+    cout << "load\tnlohmann\t" << load_nlohmann << "\n";
+
+    program fast;
+    double load_simd = mb_per_s(input.size(), reps, [&] { fast = read_program_simd(input); });
+    cout << "load\tsimd\t" << load_simd << "\t(" << load_simd / load_nlohmann << "x)\n";
+    if (program_to_json(fast).dump() + "\n" != expected) {
+        cerr << "simd load differs from nlohmann\n";
+        return 1;
+    }
+
+    double store_nlohmann = mb_per_s(bytes, reps, [&] {
+        ostringstream out;
+        out << program_to_json(prog).dump() << "\n";
+    });
+    string written;
+    double store_compact = mb_per_s(bytes, reps, [&] {
+        ostringstream out;
+        write_program_compact(out, prog);
+        written = out.str();
+    });
+    cout << "store\tnlohmann\t" << store_nlohmann << "\n";
+    cout << "store\tcompact\t" << store_compact << "\t(" << store_compact / store_nlohmann << "x)\n";
+    if (written != expected) {
+        cerr << "compact writer output differs from nlohmann\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include "passes.hpp"
+#include <iostream>
+
+using namespace std;
+
+
+// A dest that is assigned again later in the block gets a fresh name, and
+// its uses up to that next assignment read the fresh name instead. The uses
+// are rewritten as they are reached rather than by scanning ahead.
+struct pending_renames {
+    struct entry {
+        sym to;
+        int since; // the instruction that made it
+    };
+    arena_unordered_map<sym, entry> by_name;
+
+    // One rename can feed a later one (x -> x1, then the block's own x1 is
+    // renamed), so follow the chain while each step is newer than the last.
+    sym resolve(sym arg) const {
+        int since = -1;
+        for (auto it = by_name.find(arg); it != by_name.end() && it->second.since > since; it = by_name.find(arg)) {
+            since = it->second.since;
+            arg = it->second.to;
+        }
+        return arg;
+    }
+
+    void apply(bril_function& func, instr& ins) const {
+        if (by_name.empty() || !(ins.present & instr::HAS_ARGS)) return;
+        auto args = func.args_of(ins);
+        arena_vector<sym> new_args(args.begin(), args.end());
+        bool changed = false;
+        for (auto& arg : new_args) {
+            sym to = resolve(arg);
+            changed |= to != arg;
+            arg = to;
+        }
+        if (changed) ins.args = func.add_operands(new_args.data(), new_args.size());
+    }
+};
+
+// rewrites the block in place: every instruction becomes exactly one new one.
+// `taken` holds every name in the function, so a fresh dest never clashes.
+static void lvn(bril_function& func, const block& blk, const vector<sym>& params, arena_unordered_set<sym>& taken) {
+    id_span<instr> b = func.instrs_of(blk);
+    // keyed by the value numbers of the operands, not their names, so a
+    // reassigned variable can't match an entry made before it changed
+    arena_unordered_map<value, int, value_hash> table; // value -> value number
+    arena_unordered_map<sym, int> var2num;
+    arena_vector<sym> canon(1, no_sym); // value number -> the variable holding it, if one still does
+
+    // where each dest is last assigned, so "will it be overwritten" is one lookup
+    arena_unordered_map<sym, int> last_def;
+    for (int i = 0; i < (int)b.size(); ++i) {
+        if (b[i].has_dest()) last_def[b[i].dest] = i;
+    }
+    pending_renames renames;
+
+    int next_vn = 1;
+    int made = 0; // values the params and instructions made, for fresh dest names
+    auto new_number = [&](sym home) {
+        canon.push_back(home);
+        return next_vn++;
+    };
+    // variables read before the block assigns them hold their own value
+    auto number_of = [&](sym var) {
+        auto it = var2num.find(var);
+        if (it != var2num.end()) return it->second;
+        return var2num[var] = new_number(var);
+    };
+    // var now holds value number vn; if it was the only home of another
+    // value (a parameter or live-in being reassigned), that value has none
+    auto assign = [&](sym var, int vn) {
+        auto it = var2num.find(var);
+        if (it != var2num.end() && it->second != vn && canon[it->second] == var) canon[it->second] = no_sym;
+        var2num[var] = vn;
+    };
+
+    for (sym p : params) {
+        var2num[p] = new_number(p);
+        ++made;
+
+        // add to table as id of themselves, so future uses can be canon'd
+        table.insert({value{opcode::id, {(sym)var2num[p]}, literal()}, var2num[p]});
+    }
+
+    for (int i = 0; i < (int)b.size(); ++i) {
+        instr ins = b[i];
+        renames.apply(func, ins);
+        sym dest = ins.dest;
+        if (ins.has_dest()) renames.by_name.erase(dest);
+
+        // ignore things that aren't candidates for replacement
+        if (!ins.has_dest()) {
+            b[i] = ins;
+            continue;
+        }
+
+        // only pure ops are numbered: calls and allocations have side effects,
+        // a load depends on memory, and each get/undef/phi reads its own
+        // shadow value even though value::from_instr sees no operands
+        const bool is_call = !is_pure(ins.op);
+        // the scan above gave every dest in the block an entry
+        const bool will_be_overwritten = last_def.find(dest)->second > i;
+        auto fresh_dest = [&] {
+            string name = sym_name(dest) + to_string(made);
+            while (taken.count(intern(name))) name += "_";
+            ins.dest = intern(name);
+            taken.insert(ins.dest);
+            renames.by_name[dest] = {ins.dest, i};
+        };
+
+        // case for calls and everything else that isn't pure
+        if (is_call) {
+            int num = new_number(no_sym);
+            ++made;
+            if (will_be_overwritten) fresh_dest();
+
+            // do NOT add calls to table
+            assign(ins.dest, num);
+            b[i] = ins;
+            continue;
+        }
+
+        value v = value::from_instr(func, ins);
+        for (sym& val : v.vals) val = number_of(val);
+
+        // normal lvn (no side effects)
+        auto it = table.find(v);
+        if (it != table.end() && canon[it->second] != no_sym) {
+            // value already computed, reuse via id
+            const sym canonical_var = canon[it->second];
+            instr new_instr;
+            new_instr.op = opcode::id;
+            new_instr.present = instr::HAS_ARGS;
+            new_instr.args = func.add_operands({canonical_var});
+            new_instr.dest = ins.dest;
+            new_instr.type = ins.type;
+            b[i] = new_instr;
+            assign(ins.dest, it->second);
+        } else {
+            // a value whose home was reassigned is recomputed and lives here now
+            int num = it != table.end() ? it->second : new_number(no_sym);
+            ++made;
+
+            // if value will be overwritten later, give a fresh name for the uses in between
+            if (will_be_overwritten) fresh_dest();
+
+            if (it == table.end()) table.insert({std::move(v), num});
+
+            if (ins.present & instr::HAS_ARGS) {
+                arena_vector<sym> new_args;
+                for (sym arg : func.args_of(ins)) {
+                    sym home = canon[number_of(arg)];
+                    new_args.push_back(home != no_sym ? home : arg);
+                }
+                ins.args = func.add_operands(new_args.data(), new_args.size());
+            }
+
+            b[i] = ins;
+            assign(ins.dest, num);
+            canon[num] = ins.dest;
+        }
+    }
+}
+
+void lvn_pass(bril_function& func, function_analyses& fa) {
+    vector<sym> params = func_arg_names(func);
+
+    arena_unordered_set<sym> taken(params.begin(), params.end());
+    for (const instr& i : func.instrs) {
+        if (i.has_dest()) taken.insert(i.dest);
+        for (sym a : func.args_of(i)) taken.insert(a);
+    }
+
+    std::vector<block> blocks = fa.blocks();
+    for (const block& b : blocks) lvn(func, b, params, taken);
+
+    // drops the unreachable code between blocks
+    rebuild_blocks(func, blocks);
+}
@@ -0,0 +1,46 @@
+#include "opt_server.hpp"
+#include "passes.hpp"
+#include <iostream>
+
+using namespace std;
+
+// Runs a pipeline of passes in one process: parse once, transform in
+// memory, serialize once.
+// usage: opt PIPELINE [--indent N] [--stats] [-j N | --stream] [--cache DIR [--cache-size MB]]
+//            [--text | --binary | --text-in | --text-out | --binary-in | --binary-out]
+//   e.g. opt to_ssa,lvn,tdce,from_ssa --text < prog.bril
+// --stats prints how often each analysis was computed and reused to stderr
+// -j N optimizes N functions at a time (0 = one per hardware thread)
+// --stream reads, optimizes and writes one function at a time, keeping only
+//   that function in memory
+// --cache DIR reuses results for functions seen before (see pass_cache.hpp),
+//   keeping DIR under MB megabytes (default 256); prints the hit rate
+// --text / --binary read and write Bril's text syntax or the binary IR
+//   instead of json (--text-in, --binary-out etc. for one side only)
+//
+// or: opt --serve [SOCKET] [--threads N]
+// stays up and answers the same requests from optc over a Unix socket (see
+// opt_server.hpp), N at a time
+
+int main(int argc, char** argv) {
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    vector<string> args(argv + 1, argv + argc);
+    if (!args.empty() && args[0] == "--serve") {
+        string path = default_opt_socket();
+        unsigned threads = 0;
+        for (size_t i = 1; i < args.size(); ++i) {
+            if (args[i] == "--threads" && i + 1 < args.size() && parse_number_flag(args[i + 1], threads)) {
+                ++i;
+            } else if (i == 1 && args[i][0] != '-') {
+                path = args[i];
+            } else {
+                cerr << "usage: opt --serve [SOCKET] [--threads N]\n";
+                return 1;
+            }
+        }
+        return serve_opt(path, threads);
+    }
+    return opt_main(args, cin, cout, cerr);
+}
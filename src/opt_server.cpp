@@ -0,0 +1,152 @@
+#include "opt_server.hpp"
+#include "passes.hpp"
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+static opt_response answer(const opt_request& req, opt_session& session) {
+    opt_response resp;
+    istringstream in(req.input);
+    ostringstream out, err;
+    try {
+        resp.status = opt_main(req.args, in, out, err, &session);
+    } catch (const exception& e) {
+        // a bad program fails its request, not the server
+        err << "opt: " << e.what() << "\n";
+        resp.status = 1;
+    }
+    resp.out = out.str();
+    resp.err = err.str();
+    return resp;
+}
+
+// Every request interns its names into the one symbol table, which would
+// otherwise grow for as long as the server runs. Once it is past
+// symbol_limit, new requests wait for the running ones to finish and the
+// table starts over.
+class symbol_gate {
+public:
+    static constexpr size_t symbol_limit = 1 << 20;
+
+    void enter() {
+        unique_lock<mutex> l(lock_);
+        idle_.wait(l, [&] { return !draining_; });
+        ++active_;
+    }
+    void leave() {
+        lock_guard<mutex> l(lock_);
+        --active_;
+        if (symbols().size() > symbol_limit) draining_ = true;
+        if (draining_ && active_ == 0) {
+            symbols().clear();
+            draining_ = false;
+            idle_.notify_all();
+        }
+    }
+
+private:
+    mutex lock_;
+    condition_variable idle_;
+    unsigned active_ = 0;
+    bool draining_ = false;
+};
+
+// a client that stops sending or reading mid-request frees its worker after this
+static constexpr int client_timeout_seconds = 30;
+
+static void set_timeouts(int fd) {
+    timeval tv{};
+    tv.tv_sec = client_timeout_seconds;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof tv);
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof tv);
+}
+
+// Connections are queued by the accepting thread and answered by a fixed set
+// of workers. The workers keep their arenas, and the session its open
+// caches, from one request to the next.
+int serve_opt(const string& path, unsigned threads) {
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof addr.sun_path) {
+        cerr << "opt: socket path too long: " << path << "\n";
+        return 1;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0 ||
+        listen(listener, 128) < 0) {
+        cerr << "opt: cannot listen on " << path << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+    cerr << "opt: serving on " << path << " with " << threads << " threads\n";
+
+    opt_session session;
+    symbol_gate gate;
+    mutex lock;
+    condition_variable ready;
+    deque<int> pending;
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            while (true) {
+                int fd;
+                {
+                    unique_lock<mutex> l(lock);
+                    ready.wait(l, [&] { return !pending.empty(); });
+                    fd = pending.front();
+                    pending.pop_front();
+                }
+                set_timeouts(fd);
+                try {
+                    opt_request req;
+                    if (read_request(fd, req)) {
+                        opt_response resp;
+                        gate.enter();
+                        try {
+                            resp = answer(req, session);
+                        } catch (...) {
+                            gate.leave();
+                            throw;
+                        }
+                        gate.leave();
+                        write_response(fd, resp);
+                    }
+                } catch (const exception& e) {
+                    // e.g. out of memory for a huge input: drop this request, keep serving
+                    cerr << "opt: dropped a request: " << e.what() << "\n";
+                }
+                close(fd);
+            }
+        });
+    }
+
+    while (true) {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            cerr << "opt: accept failed: " << strerror(errno) << "\n";
+            break;
+        }
+        {
+            lock_guard<mutex> l(lock);
+            pending.push_back(fd);
+        }
+        ready.notify_one();
+    }
+    close(listener);
+    for (auto& w : workers) w.detach();
+    return 1;
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// opt as a long-running server on a Unix socket, so build systems that run
+// the optimizer thousands of times skip process startup and keep the symbol
+// table, the workers' arenas and the function caches warm between requests.
+// optc is the client.
+//
+// One request per connection. Integers are little-endian:
+//   request:  u32 argc, then argc times (u32 length, bytes); u64 length, input
+//   response: i32 exit status; u64 length, stdout; u64 length, stderr
+// The arguments are opt's (PIPELINE and flags) and the answer is exactly what
+// opt would print, except that messages passes write to std::cerr themselves
+// go to the server's stderr.
+
+struct opt_request {
+    std::vector<std::string> args;
+    std::string input;
+};
+
+struct opt_response {
+    int32_t status = 0;
+    std::string out;
+    std::string err;
+};
+
+// $BRIL_OPT_SOCKET, or /tmp/bril-opt-<uid>.sock
+std::string default_opt_socket();
+
+// What the server accepts; a request over any of these is dropped unanswered.
+constexpr uint32_t max_request_args = 1024;
+constexpr uint64_t max_request_arg_bytes = 64 << 10;
+constexpr uint64_t max_request_input_bytes = uint64_t(1) << 30;
+
+// All return false if the connection dropped partway; read_request also if
+// the request is over the limits above.
+bool read_request(int fd, opt_request& req);
+bool write_request(int fd, const opt_request& req);
+bool read_response(int fd, opt_response& resp);
+bool write_response(int fd, const opt_response& resp);
+
+// connected socket, or -1 with errno set
+int connect_opt_socket(const std::string& path);
+
+// Replaces any stale socket at `path` and serves requests until killed,
+// `threads` at a time (0 = one per hardware thread). Returns 1 if the socket
+// cannot be set up.
+int serve_opt(const std::string& path, unsigned threads);
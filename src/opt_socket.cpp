@@ -0,0 +1,140 @@
+#include "opt_server.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Framing shared by optc and opt --serve.
+
+std::string default_opt_socket()
+{
+    if (const char *env = std::getenv("BRIL_OPT_SOCKET"))
+        return env;
+    return "/tmp/bril-opt-" + std::to_string(getuid()) + ".sock";
+}
+
+static bool write_all(int fd, const void *p, size_t n)
+{
+    const char *c = static_cast<const char *>(p);
+    while (n > 0)
+    {
+        ssize_t k = send(fd, c, n, MSG_NOSIGNAL);
+        if (k < 0 && errno == EINTR)
+            continue;
+        if (k <= 0)
+            return false;
+        c += k;
+        n -= k;
+    }
+    return true;
+}
+
+static bool read_all(int fd, void *p, size_t n)
+{
+    char *c = static_cast<char *>(p);
+    while (n > 0)
+    {
+        ssize_t k = recv(fd, c, n, 0);
+        if (k < 0 && errno == EINTR)
+            continue;
+        if (k <= 0)
+            return false;
+        c += k;
+        n -= k;
+    }
+    return true;
+}
+
+template <typename Len>
+static bool write_string(int fd, const std::string &s)
+{
+    Len n = s.size();
+    return write_all(fd, &n, sizeof n) && write_all(fd, s.data(), s.size());
+}
+
+// Rejects a length over `max`, and grows the string as the bytes arrive
+// rather than trusting the length up front, so a peer that claims a huge
+// string and then stalls costs no memory.
+template <typename Len>
+static bool read_string(int fd, std::string &s, uint64_t max)
+{
+    Len n;
+    if (!read_all(fd, &n, sizeof n) || n > max)
+        return false;
+    constexpr size_t chunk = 1 << 20;
+    s.clear();
+    while (s.size() < n)
+    {
+        size_t have = s.size();
+        size_t k = std::min<uint64_t>(chunk, n - have);
+        s.resize(have + k);
+        if (!read_all(fd, s.data() + have, k))
+            return false;
+    }
+    return true;
+}
+
+bool write_request(int fd, const opt_request &req)
+{
+    uint32_t argc = req.args.size();
+    if (!write_all(fd, &argc, sizeof argc))
+        return false;
+    for (const auto &a : req.args)
+    {
+        if (!write_string<uint32_t>(fd, a))
+            return false;
+    }
+    return write_string<uint64_t>(fd, req.input);
+}
+
+bool read_request(int fd, opt_request &req)
+{
+    uint32_t argc;
+    if (!read_all(fd, &argc, sizeof argc) || argc > max_request_args)
+        return false;
+    req.args.resize(argc);
+    for (auto &a : req.args)
+    {
+        if (!read_string<uint32_t>(fd, a, max_request_arg_bytes))
+            return false;
+    }
+    return read_string<uint64_t>(fd, req.input, max_request_input_bytes);
+}
+
+bool write_response(int fd, const opt_response &resp)
+{
+    return write_all(fd, &resp.status, sizeof resp.status) && write_string<uint64_t>(fd, resp.out) &&
+           write_string<uint64_t>(fd, resp.err);
+}
+
+bool read_response(int fd, opt_response &resp)
+{
+    return read_all(fd, &resp.status, sizeof resp.status) && read_string<uint64_t>(fd, resp.out, UINT64_MAX) &&
+           read_string<uint64_t>(fd, resp.err, UINT64_MAX);
+}
+
+int connect_opt_socket(const std::string &path)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof addr.sun_path)
+    {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof addr) < 0)
+    {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    return fd;
+}
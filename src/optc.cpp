@@ -0,0 +1,48 @@
+#include "opt_server.hpp"
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <unistd.h>
+
+using namespace std;
+
+// Client of `opt --serve`: sends its arguments and stdin to the server and
+// prints the answer, so `optc ARGS < in > out` behaves like `opt ARGS`.
+// usage: optc [--socket PATH] PIPELINE [opt flags]
+// The socket defaults to $BRIL_OPT_SOCKET, else /tmp/bril-opt-<uid>.sock.
+// Stand-ins for the single-pass tools:
+//   lvn = optc lvn    tdce = optc tdce --indent -1
+//   to_ssa = optc to_ssa    from_ssa = optc from_ssa
+
+int main(int argc, char** argv) {
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    opt_request req;
+    string path = default_opt_socket();
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--socket") && i + 1 < argc) {
+            path = argv[++i];
+        } else {
+            req.args.push_back(argv[i]);
+        }
+    }
+
+    int fd = connect_opt_socket(path);
+    if (fd < 0) {
+        cerr << "optc: cannot connect to " << path << ": " << strerror(errno) << " (is `opt --serve` running?)\n";
+        return 1;
+    }
+    req.input.assign(istreambuf_iterator<char>(cin), istreambuf_iterator<char>());
+
+    opt_response resp;
+    if (!write_request(fd, req) || !read_response(fd, resp)) {
+        cerr << "optc: lost connection to " << path << "\n";
+        return 1;
+    }
+    close(fd);
+    cerr << resp.err;
+    cout << resp.out;
+    return resp.status;
+}
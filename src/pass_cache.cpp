@@ -0,0 +1,214 @@
+#include "pass_cache.hpp"
+#include "bril_binary.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+// ---------------------------------------------------------------------------
+// Key
+// ---------------------------------------------------------------------------
+
+namespace
+{
+
+// Two independent 64-bit lanes: FNV-1a and a multiply-rotate mix. Not
+// cryptographic, just stable across runs and builds and wide enough that
+// a collision in one cache directory is not a concern.
+class hasher
+{
+public:
+    void bytes(const void *p, size_t n)
+    {
+        const unsigned char *c = static_cast<const unsigned char *>(p);
+        for (size_t k = 0; k < n; ++k)
+        {
+            a_ = (a_ ^ c[k]) * 0x100000001b3ull;
+            b_ = ((b_ ^ c[k]) * 0x9e3779b97f4a7c15ull);
+            b_ ^= b_ >> 29;
+        }
+    }
+    void u64(uint64_t v) { bytes(&v, sizeof v); }
+    void str(const std::string &s)
+    {
+        u64(s.size());
+        bytes(s.data(), s.size());
+    }
+    void name(sym s)
+    {
+        if (s == no_sym)
+            u64(UINT64_MAX);
+        else
+            str(sym_name(s));
+    }
+
+    std::string hex() const
+    {
+        char buf[33];
+        std::snprintf(buf, sizeof buf, "%016llx%016llx", (unsigned long long)a_, (unsigned long long)b_);
+        return buf;
+    }
+
+private:
+    uint64_t a_ = 0xcbf29ce484222325ull;
+    uint64_t b_ = 0x2545f4914f6cdd1dull;
+};
+
+} // namespace
+
+std::string function_cache::key(const bril_function &func, const std::string &pipeline)
+{
+    hasher h;
+    h.u64(pass_build_version);
+    h.u64(binary_version);
+    h.str(pipeline);
+
+    h.name(func.name);
+    h.name(func.type);
+    h.u64(func.has_args);
+    h.u64(func.args.size());
+    for (const auto &a : func.args)
+    {
+        h.name(a.name);
+        h.name(a.type);
+    }
+    h.str(func.extra.empty() ? "" : func.extra.dump());
+
+    h.u64(func.instrs.size());
+    for (const instr &i : func.instrs)
+    {
+        h.u64((uint64_t)i.op << 16 | (uint64_t)i.present << 8 | i.value.kind);
+        h.name(i.dest);
+        h.name(i.type);
+        h.name(i.label);
+        if (i.value.kind == literal::char_)
+            h.name(i.value.c);
+        else
+            h.u64(i.value.u);
+        for (auto list : {func.args_of(i), func.funcs_of(i), func.labels_of(i)})
+        {
+            h.u64(list.size());
+            for (sym s : list)
+                h.name(s);
+        }
+        h.str(i.extra >= 0 ? func.extras[i.extra].dump() : "");
+    }
+    return h.hex();
+}
+
+// ---------------------------------------------------------------------------
+// Entries
+// ---------------------------------------------------------------------------
+
+function_cache::function_cache(std::string dir, uint64_t max_bytes) : dir_(std::move(dir)), max_bytes_(max_bytes)
+{
+    fs::create_directories(dir_);
+}
+
+std::string function_cache::path(const std::string &key) const
+{
+    return dir_ + "/" + key.substr(0, 2) + "/" + key.substr(2);
+}
+
+bool function_cache::lookup(const std::string &key, bril_function &func)
+{
+    std::string p = path(key);
+    std::error_code ec;
+    uint64_t size = fs::file_size(p, ec);
+    std::ifstream in(p, std::ios::binary);
+    if (ec || !in)
+    {
+        ++misses_;
+        return false;
+    }
+
+    std::unique_ptr<uint64_t[]> buf(new uint64_t[size / 8 + 1]); // binary_program wants 8-byte alignment
+    try
+    {
+        if (!in.read(reinterpret_cast<char *>(buf.get()), size))
+            throw std::runtime_error("short read");
+        binary_program bin(reinterpret_cast<const char *>(buf.get()), size);
+        if (bin.size() != 1)
+            throw std::runtime_error("not one function");
+        func = bin.function(0);
+    }
+    catch (const std::exception &)
+    {
+        fs::remove(p, ec);
+        ++misses_;
+        return false;
+    }
+    fs::last_write_time(p, fs::file_time_type::clock::now(), ec); // most recently used
+    ++hits_;
+    return true;
+}
+
+void function_cache::store(const std::string &key, const bril_function &func)
+{
+    std::string p = path(key);
+    std::error_code ec;
+    fs::create_directories(fs::path(p).parent_path(), ec);
+
+    // unique per process and call, in the same directory so rename is atomic
+    std::ostringstream tmp;
+    tmp << p << ".tmp." << getpid() << "." << temp_counter_++;
+    {
+        std::ofstream out(tmp.str(), std::ios::binary);
+        binary_writer writer(out);
+        writer.write_function(func);
+        writer.finish();
+        if (!out)
+        {
+            fs::remove(tmp.str(), ec);
+            return;
+        }
+    }
+    fs::rename(tmp.str(), p, ec);
+    if (ec)
+        fs::remove(tmp.str(), ec);
+}
+
+void function_cache::trim()
+{
+    struct entry
+    {
+        fs::file_time_type used;
+        uint64_t size;
+        fs::path path;
+    };
+    std::vector<entry> entries;
+    uint64_t total = 0;
+    std::error_code ec;
+    for (auto it = fs::recursive_directory_iterator(dir_, ec); !ec && it != fs::recursive_directory_iterator();
+         it.increment(ec))
+    {
+        if (!it->is_regular_file(ec) || it->path().filename().string().find(".tmp.") != std::string::npos)
+            continue;
+        entry e{it->last_write_time(ec), it->file_size(ec), it->path()};
+        total += e.size;
+        entries.push_back(std::move(e));
+    }
+    if (total <= max_bytes_)
+        return;
+
+    std::sort(entries.begin(), entries.end(), [](const entry &a, const entry &b) { return a.used < b.used; });
+    for (const entry &e : entries)
+    {
+        if (total <= max_bytes_ / 4 * 3)
+            break;
+        if (fs::remove(e.path, ec))
+            total -= e.size;
+    }
+}
+
+void function_cache::report(std::ostream &err, size_t h, size_t m)
+{
+    err << "cache: " << h << " hits, " << m << " misses";
+    if (h + m > 0)
+        err << " (" << (100 * h + (h + m) / 2) / (h + m) << "% hit rate)";
+    err << "\n";
+}
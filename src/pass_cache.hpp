@@ -0,0 +1,60 @@
+#pragma once
+#include "common.hpp"
+#include <atomic>
+#include <iosfwd>
+#include <string>
+
+// Opt-in on-disk cache of optimized functions (--cache DIR), so a run over a
+// mostly unchanged corpus only optimizes the functions that changed.
+//
+// The key hashes the function's full text (names, not symbol ids), the
+// pipeline and pass_build_version; the entry is the optimized function as a
+// one-function program in the binary format (bril_binary.hpp), stored at
+// DIR/<first 2 hex digits>/<rest>. Entries are written under a temporary
+// name and renamed into place, so concurrent runs can share a directory and
+// never see half an entry. A hit bumps the entry's mtime, and trim() evicts
+// the least recently used entries once the directory outgrows its bound.
+//
+// Things a pass only prints (e.g. to_ssa's progress lines) are not replayed
+// on a hit.
+
+// A checksum of the IR and pass sources, set by the Makefile
+// (-DBRIL_PASS_VERSION), so a rebuilt optimizer never serves entries that a
+// different build of the passes wrote. Builds that do not set it share 0.
+#ifndef BRIL_PASS_VERSION
+#define BRIL_PASS_VERSION 0
+#endif
+constexpr uint64_t pass_build_version = BRIL_PASS_VERSION;
+
+class function_cache {
+public:
+    explicit function_cache(std::string dir, uint64_t max_bytes = uint64_t(256) << 20);
+
+    // 128-bit key as 32 hex digits
+    static std::string key(const bril_function& func, const std::string& pipeline);
+
+    // On a hit replaces `func` with the cached result. Unreadable entries
+    // count as misses and are removed. Safe to call from several threads.
+    bool lookup(const std::string& key, bril_function& func);
+    void store(const std::string& key, const bril_function& func);
+
+    // evicts least recently used entries until the directory is at most
+    // 3/4 of its bound, if it is over
+    void trim();
+
+    size_t hits() const { return hits_; }
+    size_t misses() const { return misses_; }
+    void report(std::ostream& err) const { report(err, hits_, misses_); }
+    // one line with the hit rate; takes the counts of one run when the cache
+    // is shared by several
+    static void report(std::ostream& err, size_t hits, size_t misses);
+
+private:
+    std::string path(const std::string& key) const;
+
+    std::string dir_;
+    uint64_t max_bytes_;
+    std::atomic<size_t> hits_{0};
+    std::atomic<size_t> misses_{0};
+    std::atomic<size_t> temp_counter_{0};
+};
@@ -0,0 +1,260 @@
+#include "passes.hpp"
+#include <iostream>
+
+using namespace std;
+
+const vector<pass>& all_passes() {
+    static const vector<pass> passes = {
+        // renumbers values inside blocks; labels and terminators stay
+        {"lvn", lvn_pass, analysis::CFG | analysis::DOMINATORS | analysis::FRONTIERS},
+        // can empty (and so remove) an unlabeled block
+        {"tdce", tdce_pass, analysis::NONE},
+        {"to_ssa", convert_func_to_ssa, analysis::CFG | analysis::DOMINATORS | analysis::FRONTIERS},
+        {"from_ssa", func_from_ssa, analysis::NONE},
+    };
+    return passes;
+}
+
+const pass* find_pass(const string& name) {
+    for (const pass& p : all_passes()) {
+        if (name == p.name) return &p;
+    }
+    return nullptr;
+}
+
+bool parse_pipeline(const string& spec, vector<const pass*>& out, string& error) {
+    out.clear();
+    size_t start = 0;
+    while (true) {
+        size_t comma = spec.find(',', start);
+        string name = spec.substr(start, comma == string::npos ? string::npos : comma - start);
+        const pass* p = find_pass(name);
+        if (!p) {
+            error = name.empty() ? "empty pass name in pipeline '" + spec + "'" : "unknown pass '" + name + "'";
+            return false;
+        }
+        out.push_back(p);
+        if (comma == string::npos) return true;
+        start = comma + 1;
+    }
+}
+
+// function-major: each function goes through the whole pipeline while its
+// instructions are still in cache. The passes' scratch data lives in the
+// thread's arena, reset when the next function starts.
+static analysis_stats run_passes(bril_function& func, const vector<const pass*>& passes) {
+    thread_arena_scope scope;
+    function_arena& arena = scope.arena();
+    function_analyses fa(func);
+    for (const pass* p : passes) {
+        p->run(func, fa);
+        fa.invalidate(p->preserves);
+    }
+    analysis_stats s = fa.stats();
+    s.arena_allocations = arena.allocations();
+    s.arena_bytes = arena.bytes();
+    return s;
+}
+
+static string pipeline_name(const vector<const pass*>& passes) {
+    string name;
+    for (const pass* p : passes) name += (name.empty() ? "" : ",") + string(p->name);
+    return name;
+}
+
+static analysis_stats run_passes(bril_function& func, const vector<const pass*>& passes, function_cache* cache,
+                                 const string& pipeline) {
+    if (!cache) return run_passes(func, passes);
+    string key = function_cache::key(func, pipeline);
+    analysis_stats s;
+    if (cache->lookup(key, func)) {
+        s.cache_hits = 1;
+        return s;
+    }
+    s = run_passes(func, passes);
+    s.cache_misses = 1;
+    cache->store(key, func);
+    return s;
+}
+
+// Functions only share the symbol table, so they can run on separate threads.
+void run_pipeline(program& prog, const vector<const pass*>& passes, analysis_stats* stats, unsigned jobs,
+                  function_cache* cache) {
+    string pipeline = pipeline_name(passes);
+    vector<analysis_stats> per_func(prog.functions.size());
+    for_each_largest_first(
+        prog.functions.size(), jobs, [&](size_t f) { return prog.functions[f].instrs.size(); },
+        [&](size_t f) { per_func[f] = run_passes(prog.functions[f], passes, cache, pipeline); });
+    if (stats) {
+        for (const auto& s : per_func) *stats += s;
+    }
+}
+
+void stream_pipeline(istream& in, ostream& out, const vector<const pass*>& passes, int indent, analysis_stats* stats,
+                     const io_formats& formats, function_cache* cache) {
+    string pipeline = pipeline_name(passes);
+    format_writer writer(out, indent, formats.out);
+    json extra = read_program_streaming(in, formats, [&](bril_function& func) {
+        analysis_stats s = run_passes(func, passes, cache, pipeline);
+        if (stats) *stats += s;
+        writer.write_function(func);
+    });
+    writer.finish(extra);
+}
+
+unique_ptr<function_cache> run_options::open_cache() const {
+    if (cache_dir.empty()) return nullptr;
+    return make_unique<function_cache>(cache_dir, cache_mb << 20);
+}
+
+const char* const run_flags_usage =
+    "[-j N | --stream] [--cache DIR [--cache-size MB]] [--text | --binary | --text-in | --text-out | --binary-in | --binary-out]";
+
+bool parse_run_flag(const vector<string>& args, size_t& i, run_options& opts) {
+    const string& arg = args[i];
+    bool has_value = i + 1 < args.size();
+    if (arg == "-j" && has_value && parse_number_flag(args[i + 1], opts.jobs)) {
+        ++i;
+    } else if (arg == "--stream") {
+        opts.stream = true;
+    } else if (arg == "--cache" && has_value) {
+        opts.cache_dir = args[++i];
+    } else if (arg == "--cache-size" && has_value && parse_number_flag(args[i + 1], opts.cache_mb)) {
+        ++i;
+    } else {
+        return parse_format_flag(arg, opts.formats);
+    }
+    return true;
+}
+
+bool parse_run_flags(int argc, char** argv, run_options& opts) {
+    vector<string> args(argv + 1, argv + argc);
+    for (size_t i = 0; i < args.size(); ++i) {
+        if (!parse_run_flag(args, i, opts)) return false;
+    }
+    return true;
+}
+
+function_cache& opt_session::cache(const string& dir, uint64_t max_bytes) {
+    lock_guard<mutex> l(lock_);
+    auto& c = caches_[{dir, max_bytes}];
+    if (!c) c = make_unique<function_cache>(dir, max_bytes);
+    return *c;
+}
+
+void opt_session::finished(function_cache& cache) {
+    bool trim;
+    {
+        lock_guard<mutex> l(lock_);
+        trim = ++requests_[&cache] % trim_interval == 0;
+    }
+    if (trim) cache.trim();
+}
+
+// Runs the passes as the flags say; prints the banners and the cache's hit
+// rate to `err`. With a session the cache comes from it and stays open.
+static void run_with_options(istream& in, ostream& out, ostream& err, const vector<const pass*>& passes,
+                             int indent, const run_options& opts, analysis_stats* stats, opt_session* session,
+                             const pass_banners& banners = {}) {
+    auto banner = [&](const char* line) {
+        if (line) err << line << "\n";
+    };
+    unique_ptr<function_cache> own;
+    function_cache* cache = nullptr;
+    if (session && !opts.cache_dir.empty()) {
+        cache = &session->cache(opts.cache_dir, opts.cache_mb << 20);
+    } else {
+        own = opts.open_cache();
+        cache = own.get();
+    }
+    analysis_stats counts;
+    if (opts.stream) {
+        banner(banners.running);
+        stream_pipeline(in, out, passes, indent, &counts, opts.formats, cache);
+    } else {
+        banner(banners.reading);
+        program prog = read_program(in, opts.formats);
+        banner(banners.read);
+        banner(banners.running);
+        run_pipeline(prog, passes, &counts, opts.jobs, cache);
+        write_program(out, prog, indent, opts.formats);
+    }
+    if (stats) *stats += counts;
+    if (cache) {
+        function_cache::report(err, counts.cache_hits, counts.cache_misses);
+        if (session) {
+            session->finished(*cache);
+        } else {
+            cache->trim();
+        }
+    }
+}
+
+int run_single_pass(const char* name, int indent, int argc, char** argv, const pass_banners& banners) {
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
+
+    run_options opts;
+    if (!parse_run_flags(argc, argv, opts)) {
+        cerr << "usage: " << argv[0] << " " << run_flags_usage << "\n";
+        return 1;
+    }
+    run_with_options(cin, cout, cerr, {find_pass(name)}, indent, opts, nullptr, nullptr, banners);
+    return 0;
+}
+
+static void opt_usage(ostream& err) {
+    err << "usage: opt PIPELINE [--indent N] [--stats] " << run_flags_usage << "\npasses:";
+    for (const pass& p : all_passes()) err << " " << p.name;
+    err << "\n";
+}
+
+int opt_main(const vector<string>& args, istream& in, ostream& out, ostream& err, opt_session* session) {
+    string spec;
+    int indent = 2;
+    bool stats = false;
+    run_options opts;
+    for (size_t i = 0; i < args.size(); ++i) {
+        const string& arg = args[i];
+        if (arg == "--indent" && i + 1 < args.size() && parse_number_flag(args[i + 1], indent)) {
+            ++i;
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (parse_run_flag(args, i, opts)) {
+        } else if (spec.empty() && !arg.empty() && arg[0] != '-') {
+            spec = arg;
+        } else {
+            opt_usage(err);
+            return 1;
+        }
+    }
+    if (spec.empty()) {
+        opt_usage(err);
+        return 1;
+    }
+
+    vector<const pass*> passes;
+    string error;
+    if (!parse_pipeline(spec, passes, error)) {
+        err << "opt: " << error << "\n";
+        opt_usage(err);
+        return 1;
+    }
+
+    analysis_stats counts;
+    run_with_options(in, out, err, passes, indent, opts, &counts, session);
+
+    if (stats) {
+        err << "analysis\tcomputed\treused\n";
+        for (int i = 0; i < analysis::COUNT; ++i) {
+            if (counts.computed[i] || counts.reused[i]) {
+                err << analysis_name(i) << "\t" << counts.computed[i] << "\t" << counts.reused[i] << "\n";
+            }
+        }
+        if (counts.arena_allocations) {
+            err << "arena: " << counts.arena_allocations << " allocations, " << (counts.arena_bytes + 1023) / 1024
+                << " KB\n";
+        }
+    }
+    return 0;
+}
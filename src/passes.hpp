@@ -0,0 +1,98 @@
+#pragma once
+#include "analysis.hpp"
+#include "bril_io.hpp"
+#include "pass_cache.hpp"
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Function passes. Each rewrites one function in place, taking what it
+// needs from the function's analysis cache.
+void lvn_pass(bril_function& func, function_analyses& fa);
+void tdce_pass(bril_function& func, function_analyses& fa);
+void convert_func_to_ssa(bril_function& func, function_analyses& fa);
+void func_from_ssa(bril_function& func, function_analyses& fa);
+
+// `preserves` lists the analyses still valid after the pass; the rest are
+// dropped before the next pass runs. Preserving CFG promises the same block
+// split, labels and edges even if instructions inside the blocks changed.
+struct pass {
+    const char* name;
+    void (*run)(bril_function&, function_analyses&);
+    analysis_set preserves;
+};
+
+// every registered pass, in no particular order; nullptr when unknown
+const std::vector<pass>& all_passes();
+const pass* find_pass(const std::string& name);
+
+// splits a comma-separated pipeline such as "to_ssa,lvn,tdce,from_ssa";
+// on an unknown or empty pass name fills `error` and returns false
+bool parse_pipeline(const std::string& spec, std::vector<const pass*>& out, std::string& error);
+
+// runs the passes in order over every function of the program, with one
+// analysis cache per function; adds the cache's hit counts to `stats`.
+// jobs > 1 (0 = one per hardware thread) processes functions concurrently,
+// largest first; the program keeps its function order. With a function
+// cache, functions it already holds skip the passes.
+void run_pipeline(program& prog, const std::vector<const pass*>& passes, analysis_stats* stats = nullptr,
+                  unsigned jobs = 1, function_cache* cache = nullptr);
+
+// Reads, transforms and writes one function at a time (see
+// read_program_streaming), so memory is bounded by the largest function.
+// Always serial.
+void stream_pipeline(std::istream& in, std::ostream& out, const std::vector<const pass*>& passes, int indent,
+                     analysis_stats* stats = nullptr, const io_formats& formats = {},
+                     function_cache* cache = nullptr);
+
+// Flags every pass-running tool takes.
+struct run_options {
+    unsigned jobs = 1;
+    bool stream = false;
+    io_formats formats;
+    std::string cache_dir; // --cache DIR; empty for none
+    uint64_t cache_mb = 256; // --cache-size MB
+
+    // the cache the flags ask for, or nullptr
+    std::unique_ptr<function_cache> open_cache() const;
+};
+
+// Takes -j N, --stream, --cache DIR, --cache-size MB or a format flag at
+// args[i], moving i past a flag's value; false if args[i] is none of these.
+bool parse_run_flag(const std::vector<std::string>& args, size_t& i, run_options& opts);
+// all of argv through parse_run_flag; false on anything else
+bool parse_run_flags(int argc, char** argv, run_options& opts);
+extern const char* const run_flags_usage;
+
+// Progress lines a single-pass tool prints to stderr; nullptr for none.
+// With --stream there is no separate read, so only `running` is printed.
+struct pass_banners {
+    const char* reading = nullptr; // before the program is read
+    const char* read = nullptr;    // once it is
+    const char* running = nullptr; // before the pass runs
+};
+
+// shared main() of the single-pass wrappers: read stdin, run, write stdout
+int run_single_pass(const char* name, int indent, int argc, char** argv, const pass_banners& banners = {});
+
+// What opt --serve keeps between requests: function caches stay open, and
+// their directories are trimmed every trim_interval requests rather than
+// after each one. Safe to share between threads.
+class opt_session {
+public:
+    function_cache& cache(const std::string& dir, uint64_t max_bytes);
+    // called when a request that used `cache` is done
+    void finished(function_cache& cache);
+
+    static constexpr unsigned trim_interval = 64;
+
+private:
+    std::mutex lock_;
+    std::map<std::pair<std::string, uint64_t>, std::unique_ptr<function_cache>> caches_;
+    std::map<const function_cache*, unsigned> requests_;
+};
+
+// opt's main(): `args` leaves out the program name; returns the exit status
+int opt_main(const std::vector<std::string>& args, std::istream& in, std::ostream& out, std::ostream& err,
+             opt_session* session = nullptr);
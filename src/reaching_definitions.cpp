@@ -1,136 +1,63 @@
-#include "common.hpp"
+#include "analysis.hpp"
 #include <iostream>
 
 using namespace std;
 
-// in[entry] = init
-// out[*] = init
+// Reaching definitions on the shared bit-vector solver (see dataflow.hpp):
+// forward, meet = union, out[b] = gen[b] ∪ (in[b] - kill[b]).
 
-// worklist = all blocks
-// while worklist is not empty:
-//     b = pick any block from worklist
-//     in[b] = merge(out[p] for every predecessor p of b)
-//     out[b] = transfer(b, in[b])
-//     if out[b] changed:
-//         worklist += successors of b
-
-struct definition {
-    string var;
-    json instr;
-
-    bool operator==(const definition& other) const {
-        return var == other.var && instr == other.instr;
-    }
-};
-
-namespace std {
-    template<>
-    struct hash<definition> {
-        size_t operator()(const definition& def) const {
-            size_t h = hash<string>{}(def.instr.dump());
-            return h;
-        }
-    };
-}
-
-unordered_set<definition> reaching_transfer(vector<json> block, unordered_set<definition> in){ 
-    unordered_set<definition> out = in;
+int main(int argc, char** argv) {
+    ios::sync_with_stdio(false);
+    cin.tie(nullptr);
 
-    for (json instr : block) {
-        if (has_dest(instr)) {
-            string dest = instr["dest"].get<string>();
-            definition def = {dest, instr};
-            // delete all occurences of instructions that define dest
-            for (auto it = out.begin(); it != out.end(); ) {
-                if (it->var == dest) {
-                    // cout << "Removing definition of " << dest << " at " << it->instr.dump() << "\n";
-                    it = out.erase(it);
-                } else {
-                    ++it;
-                }
-            }
-            out.emplace(def);
+    // usage: reaching_definitions [--solver worklist|scc|parallel] [--threads N] [--stats] [-j N | --stream] [--func PATTERN]... [--text | --binary]
+    // --stats prints each function's block visits to stderr
+    // -j N analyzes N functions at a time; output stays in function order
+    // --stream reads and analyzes one function at a time, keeping only that one in memory
+    // --func PATTERN only decodes and analyzes functions with that name, or whose name
+    //   matches it as a regex; may be repeated
+    // --text / --binary read Bril's text syntax or the binary IR instead of json
+    solve_mode mode = solve_mode::worklist;
+    unsigned threads = 0; // parallel solver only; 0 = this function's share of the hardware
+    bool stats = false;
+    tool_input input;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--solver" && i + 1 < argc && solve_mode_from_name(argv[i + 1], mode)) {
+            ++i;
+        } else if (arg == "--threads" && i + 1 < argc && parse_number_flag(argv[i + 1], threads)) {
+            ++i;
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (parse_tool_input_flag(argc, argv, i, input)) {
+        } else {
+            cerr << "usage: " << argv[0] << " [--solver worklist|scc|parallel] [--threads N] [--stats] " << tool_input_usage << "\n";
+            return 1;
         }
     }
 
-    return out;
-};
-
-unordered_map<string, unordered_set<definition>> reaching_definitions(string func_name, vector<vector<json>> blocks) {
-    unordered_map<string, unordered_set<definition>> in;
-    unordered_map<string, unordered_set<definition>> out;
-    unordered_map<string, vector<json>> label_to_block;
-    vector<string> worklist;
-    cfg_info cfg = build_cfg(func_name, blocks);
-
-    // debug: print cfg - looks correct to me!
-    // for (const auto& [label, preds] : cfg.predecessors) {
-    //     cout << "Block " << label << " has predecessors: ";
-    //     for (const auto& p : preds) cout << p << " ";
-    //     cout << "\n";
-    // }
-
-    // in and out are empty as defaults
-    for (size_t i = 0; i < blocks.size(); ++i) {
-        string label = get_label(blocks, func_name, i);
-        in.emplace(label, unordered_set<definition>());
-        out.emplace(label, unordered_set<definition>());
-        label_to_block.emplace(label, blocks[i]);
-        worklist.push_back(label);
-    }
-
-    while (worklist.size() > 0) {
-        // cout << "Worklist size: " << worklist.size() << "\n";
-        string label = worklist[worklist.size() - 1]; // take a block from the worklist
-        worklist.pop_back(); // remove the block from the worklist
-        vector<json> block = label_to_block[label];
-
-        // merge all the output of all predeccesors of block
-        unordered_set<definition> merged_set;
-        for (string pred : cfg.predecessors[label]) {
-            for (definition d : out[pred]){
-                merged_set.insert(d);
-            }
-        }
-
-        in[label] = merged_set;
-
-        // apply transfer func 
-        unordered_set<definition> new_out = reaching_transfer(block, in[label]);
-        if (new_out != out[label]) {
-            out[label] = new_out;
-            for (string successor : cfg.successors[label]) {
-                worklist.push_back(successor);
-            }
+    threads = threads_per_function(input, threads);
+    analysis_options opts;
+    opts.solver = mode;
+    opts.threads = threads;
+    auto analyze = [&](const bril_function& func, ostream& out, ostream& err) {
+        function_analyses fa(func, opts);
+        const cfg_info& cfg = fa.cfg();
+
+        // out << "Function: " << sym_name(func.name) << "\n";
+        const reaching_result& reaching_defs = fa.reaching();
+        if (stats) {
+            err << sym_name(func.name) << ": " << reaching_defs.visits << " block visits, " << cfg.size() << " blocks\n";
         }
-    }
-
-    return out;
-}
-
-
-
-int main() {
-    ios::sync_with_stdio(false);
-    cin.tie(nullptr);
-
-    std::string input((std::istreambuf_iterator<char>(cin)), std::istreambuf_iterator<char>());
-    json bril = json::parse(input);
-
-    json out_funcs = json::array();
-    for (const auto& func : bril.at("functions")) {
-        auto blocks = gen_basic_blocks(func);
-
-        // cout << "Function: " << func["name"] << "\n";
-        auto reaching_defs = reaching_definitions(func["name"], blocks); 
 
         // print out reaching definitions
-        for (const auto& [label, defs] : reaching_defs) {
-            cout << "Block " << label << ":\n";
-            for (const auto& def : defs) {
-                cout << "  " << def.var << " defined at " << def.instr.dump() << "\n"; 
-            }
+        for (block_id label = 0; label < cfg.size(); ++label) {
+            out << "Block " << sym_name(cfg.labels[label]) << ":\n";
+            reaching_defs.out[label].for_each([&](size_t d) {
+                out << "  " << sym_name(reaching_defs.vars[d]) << " defined at " << reaching_defs.names[d] << "\n";
+            });
         }
-    }
-}
+    };
 
+    analyze_functions(cin, input, analyze);
+}
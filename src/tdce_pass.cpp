@@ -0,0 +1,73 @@
+#include "passes.hpp"
+#include <iostream>
+
+using namespace std;
+
+static void local_tdce(bril_function& func, const block& b, block_rewrite& edits) {
+    enum { UNSEEN = 0, LATER_DEF_NO_USE = 1, USED_SINCE = 2 };
+    arena_unordered_map<sym, int> state;
+
+    for (uint32_t k = b.end; k-- > b.begin;) {
+        instr& instr = func.instrs[k];
+        bool keep = true;
+
+        if (has_dest(instr)) {
+            const sym x = instr.dest;
+            auto it = state.find(x);
+
+            // if we've seen a later def with no intervening use, this def is
+            // dead; a call still has to run, it just loses its result
+            if (it != state.end() && it->second == LATER_DEF_NO_USE) {
+                keep = has_side_effects(instr.op);
+                instr.dest = no_sym;
+                instr.type = no_sym;
+            }
+            state[x] = LATER_DEF_NO_USE;
+        }
+
+        if (keep) {
+            for (sym a : func.args_of(instr)) state[a] = USED_SINCE;
+        } else {
+            edits.erase(k);
+        }
+    }
+}
+
+static bool drop_globally_unused_once(bril_function& func, arena_unordered_set<sym>& used) {
+    used.clear();
+    for (const auto& instr : func.instrs) {
+        for (sym a : func.args_of(instr)) used.insert(a);
+    }
+
+    std::vector<instr> filtered;
+    filtered.reserve(func.instrs.size());
+    for (auto instr : func.instrs) {
+        if (has_dest(instr) && used.find(instr.dest) == used.end()) {
+            if (!has_side_effects(instr.op)) continue; // prune dead assign
+            instr.dest = no_sym;
+            instr.type = no_sym;
+        }
+        filtered.push_back(instr);
+    }
+
+    bool changed = (filtered.size() != func.instrs.size());
+    func.instrs = std::move(filtered);
+    return changed;
+}
+
+static void optimize_globally_unused_vars(bril_function& func) {
+    arena_unordered_set<sym> used; // reused by every round
+    while (drop_globally_unused_once(func, used)) { /* iterate to fixpoint */ }
+}
+
+void tdce_pass(bril_function& func, function_analyses&) {
+    // global pass
+    optimize_globally_unused_vars(func);
+
+    // gen basic blocks + local pass
+    auto blocks = gen_basic_blocks(func);
+    block_rewrite edits;
+    for (const auto& b : blocks) local_tdce(func, b, edits);
+
+    rebuild_blocks(func, blocks, std::move(edits));
+}
@@ -0,0 +1,295 @@
+#include "passes.hpp"
+#include "dominators.hpp"
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <queue>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+using block_set = arena_unordered_set<block_id>;
+
+vector<unordered_set<sym>> compute_get_targets(
+    size_t num_blocks,
+    const vector<vector<block_id>> &frontiers,
+    const unordered_map<sym, vector<block_id>> &definitions)
+{
+    vector<unordered_set<sym>> need_get(num_blocks);
+
+    for (const auto &[var, def_blocks] : definitions)
+    {
+        arena_vector<block_id> worklist(def_blocks.begin(), def_blocks.end());
+        block_set defsites(def_blocks.begin(), def_blocks.end());
+
+        while (!worklist.empty())
+        {
+            block_id b = worklist.back();
+            worklist.pop_back();
+
+            for (block_id d : frontiers[b])
+            {
+                if (!need_get[d].count(var))
+                {
+                    need_get[d].insert(var);
+
+                    if (!defsites.count(d))
+                    {
+                        defsites.insert(d);
+                        worklist.push_back(d);
+                    }
+                }
+            }
+        }
+    }
+
+    return need_get;
+}
+
+struct RenameInfo
+{
+    vector<vector<tuple<block_id, sym, sym>>> sets; // block -> [(succ, old, val)]
+    vector<unordered_map<sym, sym>> get_targets;    // block -> {old : new}
+    unordered_map<sym, sym> initial_values;         // old -> init name
+};
+
+RenameInfo perform_ssa_renaming(
+    bril_function &func,
+    const vector<block> &blocks,
+    const cfg_info &cfg,
+    const vector<unordered_set<sym>> &need_get,
+    const dominator_tree &dom_tree,
+    const unordered_set<sym> &args)
+{
+    // top of each stack is back(); every block pops what it pushed once its
+    // dominator tree children are done
+    arena_unordered_map<sym, arena_vector<sym>> name_stack;
+    for (sym a : args)
+        name_stack[a].push_back(a);
+
+    vector<unordered_map<sym, sym>> get_target_map(blocks.size());
+    for (block_id b = 0; b < blocks.size(); ++b)
+    {
+        for (sym v : need_get[b])
+            get_target_map[b][v] = no_sym;
+    }
+
+    vector<vector<tuple<block_id, sym, sym>>> outgoing_sets(blocks.size());
+
+    unordered_map<sym, sym> inits;
+    arena_unordered_map<sym, int> version_ctr;
+    arena_vector<sym> pushed; // vars pushed by the blocks currently being renamed
+
+    auto new_name = [&](sym v)
+    {
+        sym n = intern(sym_name(v) + "." + to_string(version_ctr[v]++));
+        name_stack[v].push_back(n);
+        pushed.push_back(v);
+        return n;
+    };
+
+    auto current_name = [&](sym v) -> sym
+    {
+        auto it = name_stack.find(v);
+        if (it != name_stack.end() && !it->second.empty())
+            return it->second.back();
+        sym init = intern(sym_name(v) + ".init");
+        inits[v] = init;
+        return init;
+    };
+
+    // a block on the dominator tree walk; its children are kids[next, end)
+    struct frame
+    {
+        size_t saved; // pushed.size() before the block
+        size_t begin, next, end;
+    };
+    arena_vector<frame> stack;
+    arena_vector<block_id> kids; // the children of every block on the stack, in label order
+
+    auto enter_block = [&](block_id bname)
+    {
+        cerr << "Renaming block " + sym_name(cfg.labels[bname]) + "\n"; // one write, whole lines under -j
+        size_t saved = pushed.size();
+
+        for (sym v : need_get[bname])
+            get_target_map[bname][v] = new_name(v);
+
+        // Rename args and dests
+        for (auto &inst : func.instrs_of(blocks[bname]))
+        {
+            for (auto &a : func.args_of(inst))
+                a = current_name(a);
+            if (inst.has_dest())
+                inst.dest = new_name(inst.dest);
+        }
+
+        // Add sets to successors
+        for (block_id succ_block : cfg.successors(bname))
+        {
+            for (sym v : need_get[succ_block])
+                outgoing_sets[bname].push_back(
+                    make_tuple(succ_block, v, current_name(v)));
+        }
+
+        // Queue the dominator tree children
+        size_t begin = kids.size();
+        auto children = dom_tree.children(bname);
+        kids.insert(kids.end(), children.begin(), children.end());
+        sort(kids.begin() + begin, kids.end(), [&](block_id x, block_id y)
+             { return name_less(cfg.labels[x], cfg.labels[y]); });
+        stack.push_back({saved, begin, begin, kids.size()});
+    };
+
+    // Walk the dominator tree with an explicit stack, so a long chain of
+    // blocks can't overflow the call stack
+    enter_block(0);
+    while (!stack.empty())
+    {
+        frame &f = stack.back();
+        if (f.next < f.end)
+        {
+            block_id c = kids[f.next++];
+            enter_block(c);
+            continue;
+        }
+
+        while (pushed.size() > f.saved)
+        {
+            name_stack[pushed.back()].pop_back();
+            pushed.pop_back();
+        }
+        kids.resize(f.begin);
+        stack.pop_back();
+    }
+
+    return {outgoing_sets, get_target_map, inits};
+}
+
+void add_sets_and_gets(
+    bril_function &func,
+    const vector<block> &blocks,
+    const cfg_info &cfg,
+    const vector<vector<tuple<block_id, sym, sym>>> &sets,
+    const vector<unordered_map<sym, sym>> &get_targets,
+    const unordered_map<sym, sym> &types,
+    block_rewrite &edits)
+{
+    for (block_id b = 0; b < blocks.size(); ++b)
+    {
+        const block &range = blocks[b];
+
+        // GETs at the top
+        uint32_t top = (!range.empty() && func.instrs[range.begin].is_label()) ? range.begin + 1 : range.begin;
+        vector<pair<sym, sym>> gvec(get_targets[b].begin(), get_targets[b].end());
+        sort(gvec.begin(), gvec.end(), [](const auto &x, const auto &y)
+             { return name_less(x.first, y.first); });
+        for (const auto &[oldv, newv] : gvec)
+        {
+            if (newv == no_sym)
+                continue;
+            instr g;
+            g.op = opcode::get;
+            g.dest = newv;
+            g.type = types.at(oldv);
+            edits.insert(b, top, g);
+        }
+
+        // SETs before the terminator; where the block is only a terminator
+        // they land after the GETs
+        auto svec = sets[b];
+        sort(svec.begin(), svec.end(), [&](const auto &x, const auto &y)
+             {
+                 if (get<0>(x) != get<0>(y))
+                     return name_less(cfg.labels[get<0>(x)], cfg.labels[get<0>(y)]);
+                 if (get<1>(x) != get<1>(y))
+                     return name_less(get<1>(x), get<1>(y));
+                 return name_less(get<2>(x), get<2>(y));
+             });
+        uint32_t insert_pos = range.end;
+        if (!range.empty() && is_terminator(func.instrs[range.end - 1].op))
+            insert_pos = range.end - 1;
+
+        for (const auto &[succ, var, val] : svec)
+        {
+            const auto &mapping = get_targets[succ];
+            auto m_it = mapping.find(var);
+            if (m_it == mapping.end() || m_it->second == no_sym)
+                continue;
+
+            instr inst;
+            inst.op = opcode::set;
+            inst.present = instr::HAS_ARGS;
+            inst.args = func.add_operands({m_it->second, val});
+            edits.insert(b, insert_pos, inst);
+        }
+    }
+}
+
+// in front of everything else in the entry block, even its label
+void add_undef_inits(
+    const block &entry_block,
+    const unordered_map<sym, sym> &inits,
+    const unordered_map<sym, sym> &types,
+    block_rewrite &edits)
+{
+    vector<pair<sym, sym>> sorted(inits.begin(), inits.end());
+    sort(sorted.begin(), sorted.end(), [](const auto &x, const auto &y)
+         { return name_less(x.first, y.first); });
+    for (auto it = sorted.rbegin(); it != sorted.rend(); ++it)
+    {
+        instr u;
+        u.op = opcode::undef;
+        u.type = types.at(it->first);
+        u.dest = it->second;
+        edits.insert(0, entry_block.begin, u);
+    }
+}
+
+unordered_map<sym, sym> collect_types(const bril_function &func)
+{
+    unordered_map<sym, sym> t;
+    for (const auto &a : func.args)
+        t[a.name] = a.type;
+
+    for (const auto &i : func.instrs)
+        if (i.has_dest())
+            t[i.dest] = i.type;
+    return t;
+}
+
+// Only adds instructions inside existing blocks once the entry block is in
+// place, so the CFG, dominators and frontiers stay valid for later passes.
+void convert_func_to_ssa(bril_function &func, function_analyses &fa)
+{
+    if (add_entry(func, fa.blocks()))
+        fa.invalidate(); // the new entry changes every block id
+
+    vector<block> blocks = fa.blocks();
+    const cfg_info &cfg = fa.cfg();
+    const dominator_tree &dom_tree = fa.dom_tree();
+    const auto &frontiers = fa.frontiers();
+    auto defs = def_blocks(func, blocks);
+    auto types = collect_types(func);
+
+    unordered_set<sym> arg_names;
+    for (const auto &a : func.args)
+        arg_names.insert(a.name);
+
+    auto need_get = compute_get_targets(blocks.size(), frontiers, defs);
+    auto [sets, gets, inits] =
+        perform_ssa_renaming(func, blocks, cfg, need_get, dom_tree, arg_names);
+
+    // undefs, then gets, then sets, for where they meet in one place
+    block_rewrite edits;
+    if (!blocks.empty())
+        add_undef_inits(blocks[0], inits, types, edits);
+    add_sets_and_gets(func, blocks, cfg, sets, gets, types, edits);
+
+    rebuild_blocks(func, blocks, std::move(edits));
+}
@@ -0,0 +1,112 @@
+#include "work_pool.hpp"
+#include <algorithm>
+#include <thread>
+
+using namespace std;
+
+// index of the worker running on this thread inside run(), or -1
+static thread_local int current_worker = -1;
+
+work_pool::work_pool(unsigned threads)
+    : threads_(threads ? threads : max(1u, thread::hardware_concurrency())), queues_(threads_) {}
+
+void work_pool::run(vector<task> tasks) {
+    pending_ += tasks.size();
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        queues_[i % threads_].tasks.push_back(move(tasks[i]));
+    }
+
+    vector<thread> helpers;
+    for (unsigned id = 1; id < threads_; ++id) helpers.emplace_back(&work_pool::work, this, id);
+    work(0);
+    for (auto& t : helpers) t.join();
+}
+
+void work_pool::spawn(task t) {
+    unsigned id = current_worker < 0 ? 0 : current_worker;
+    pending_.fetch_add(1, memory_order_relaxed);
+    {
+        lock_guard<mutex> g(queues_[id].lock);
+        queues_[id].tasks.push_back(move(t));
+    }
+    {
+        // under the lock, so a worker about to sleep sees it
+        lock_guard<mutex> g(idle_lock_);
+        spawned_.fetch_add(1, memory_order_relaxed);
+    }
+    idle_.notify_one();
+}
+
+// own queue from the back (most recently spawned, still warm in cache),
+// then the others' from the front
+bool work_pool::next_task(unsigned id, task& out) {
+    {
+        lock_guard<mutex> g(queues_[id].lock);
+        if (!queues_[id].tasks.empty()) {
+            out = move(queues_[id].tasks.back());
+            queues_[id].tasks.pop_back();
+            return true;
+        }
+    }
+    for (unsigned k = 1; k < threads_; ++k) {
+        worker_queue& victim = queues_[(id + k) % threads_];
+        lock_guard<mutex> g(victim.lock);
+        if (!victim.tasks.empty()) {
+            out = move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void work_pool::work(unsigned id) {
+    current_worker = id;
+    task t;
+    for (;;) {
+        uint64_t seen = spawned_.load(memory_order_acquire);
+        if (next_task(id, t)) {
+            t();
+            t = nullptr;
+            if (pending_.fetch_sub(1, memory_order_acq_rel) == 1) {
+                lock_guard<mutex> g(idle_lock_);
+                idle_.notify_all();
+            }
+            continue;
+        }
+        // nothing to steal: the running tasks may still spawn some, so sleep
+        // until one does or they have all finished
+        unique_lock<mutex> l(idle_lock_);
+        idle_.wait(l, [&] {
+            return pending_.load(memory_order_acquire) == 0 || spawned_.load(memory_order_relaxed) != seen;
+        });
+        if (pending_.load(memory_order_acquire) == 0) break;
+    }
+    current_worker = -1;
+}
+
+void for_each_largest_first(size_t n, unsigned threads, const function<size_t(size_t)>& cost,
+                            const function<void(size_t)>& f) {
+    if (!threads) threads = max(1u, thread::hardware_concurrency());
+    if (threads == 1 || n <= 1) {
+        for (size_t i = 0; i < n; ++i) f(i);
+        return;
+    }
+
+    vector<size_t> costs(n), order(n);
+    for (size_t i = 0; i < n; ++i) {
+        costs[i] = cost(i);
+        order[i] = i;
+    }
+    // stable, so equal costs keep index order
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return costs[a] > costs[b]; });
+
+    atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t k; (k = next.fetch_add(1, memory_order_relaxed)) < n;) f(order[k]);
+    };
+    vector<thread> helpers;
+    for (unsigned t = 1; t < min<size_t>(threads, n); ++t) helpers.emplace_back(worker);
+    worker();
+    for (auto& t : helpers) t.join();
+}
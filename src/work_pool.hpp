@@ -0,0 +1,55 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Work-stealing task pool. Each worker owns a deque: it pushes and pops its
+// own tasks at the back and steals from the front of the others' when it
+// runs dry, and sleeps when there is nothing to steal until a task is
+// spawned. Tasks may spawn more tasks; run() returns once every task,
+// including spawned ones, has finished.
+class work_pool {
+public:
+    using task = std::function<void()>;
+
+    // threads counts the caller, which works during run(); 0 means one per
+    // hardware thread
+    explicit work_pool(unsigned threads = 0);
+
+    unsigned size() const { return threads_; }
+
+    // runs the given tasks (handed out round-robin) and all they spawn
+    void run(std::vector<task> tasks);
+
+    // queue another task on the current worker; only valid inside run()
+    void spawn(task t);
+
+private:
+    struct worker_queue {
+        std::mutex lock;
+        std::deque<task> tasks;
+    };
+
+    void work(unsigned id);
+    bool next_task(unsigned id, task& out);
+
+    unsigned threads_;
+    std::vector<worker_queue> queues_;
+    std::atomic<size_t> pending_{0}; // spawned but not finished
+
+    // idle workers wait on `idle_` until `spawned_` moves or pending_ hits 0
+    std::mutex idle_lock_;
+    std::condition_variable idle_;
+    std::atomic<uint64_t> spawned_{0};
+};
+
+// Calls f(i) for every i in [0, n) on `threads` threads (0 = one per hardware
+// thread), handing out indices by descending cost so the biggest items start
+// first and a huge one cannot be left running alone at the end. With one
+// thread it is a plain loop in index order.
+void for_each_largest_first(size_t n, unsigned threads, const std::function<size_t(size_t)>& cost,
+                            const std::function<void(size_t)>& f);
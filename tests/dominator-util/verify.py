@@ -11,8 +11,8 @@ bril_files = glob.glob(os.path.join(bril_dir, "*.bril"))
 flag = True
 for bril_file in bril_files:
     # print(f"Processing {bril_file}...")
-    # Run the command: bril2json < file | build/dominator_util
-    cmd = f"bril2json < {bril_file} | ../../src/build/dominator_util"
+    # Run the command: build/dominator_util --verify --text < file
+    cmd = f"../../src/build/dominator_util --verify --text < {bril_file}"
     result = subprocess.run(cmd, shell=True, capture_output=True, text=True)
 
     # Print stdout